@@ -3,15 +3,30 @@
         {
             "target_name": "cytubefilters",
             "sources": [
+                "src/ahocorasick.cc",
+                "src/allocations.cc",
+                "src/executor.cc",
                 "src/filter.cc",
                 "src/filterlist.cc",
                 "src/jsfilterlist.cc",
-                "src/util.cc"
+                "src/literal.cc",
+                "src/literalrun.cc",
+                "src/pattern.cc",
+                "src/patterncache.cc",
+                "src/replacement.cc",
+                "src/utf8.cc",
+                "src/util.cc",
+                "src/wordlist.cc"
             ],
             "dependencies": [
                 "deps/libpcre/libpcre.gyp:libpcre"
             ],
-            "include_dirs": ["<!(node -e \"require('nan')\")", "/usr/include", "deps/libpcre"]
+            "include_dirs": ["<!(node -e \"require('nan')\")", "/usr/include", "deps/libpcre"],
+            "configurations": {
+                "Debug": {
+                    "ldflags": ["-Wl,-Bsymbolic"]
+                }
+            }
         }
     ]
 }
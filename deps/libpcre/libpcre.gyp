@@ -1,4 +1,7 @@
 {
+    "variables": {
+        "pcre_jit%": 0
+    },
     "targets": [
         {
             "target_name": "libpcre",
@@ -39,6 +42,9 @@
                 [ "OS=='linux'", {
                     "include_dirs": ["linux"]
                 }],
+                [ "OS=='linux' and pcre_jit==1", {
+                    "defines": ["SUPPORT_JIT"]
+                }],
                 [ "OS=='freebsd'", {
                     "include_dirs": ["freebsd"]
                 }],
@@ -80,7 +80,8 @@ static const string empty_string;
 // If the user doesn't ask for any options, we just use this one
 static RE_Options default_options;
 
-void RE::Init(const string& pat, const RE_Options* options) {
+void RE::Init(const string& pat, const RE_Options* options,
+              pcre* compiled) {
   pattern_ = pat;
   if (options == NULL) {
     options_ = default_options;
@@ -90,16 +91,32 @@ void RE::Init(const string& pat, const RE_Options* options) {
   error_ = &empty_string;
   re_full_ = NULL;
   re_partial_ = NULL;
+  extra_ = NULL;
+  backref_max_ = 0;
+  capture_count_ = 0;
 
-  re_partial_ = Compile(UNANCHORED);
+  re_partial_ = (compiled != NULL) ? compiled : Compile(UNANCHORED);
   if (re_partial_ != NULL) {
+    pcre_fullinfo(re_partial_, NULL, PCRE_INFO_BACKREFMAX, &backref_max_);
+    pcre_fullinfo(re_partial_, NULL, PCRE_INFO_CAPTURECOUNT, &capture_count_);
+  }
+  if (re_partial_ != NULL && options_.full_match()) {
     re_full_ = Compile(ANCHOR_BOTH);
   }
+  if (re_partial_ != NULL && (options_.study() || options_.jit())) {
+    // A NULL return without an error just means that studying found
+    // nothing useful; either way we match with whatever we have.
+    const char* study_error;
+    extra_ = pcre_study(re_partial_,
+                        options_.jit() ? PCRE_STUDY_JIT_COMPILE : 0,
+                        &study_error);
+  }
 }
 
 void RE::Cleanup() {
   if (re_full_ != NULL)         (*pcre_free)(re_full_);
   if (re_partial_ != NULL)      (*pcre_free)(re_partial_);
+  if (extra_ != NULL)           pcre_free_study(extra_);
   if (error_ != &empty_string)  delete error_;
 }
 
@@ -329,20 +346,68 @@ bool RE::FindAndConsume(StringPiece* input,
   }
 }
 
+class RE::StringRewriter : public RE::Rewriter {
+ public:
+  StringRewriter(const RE& re, const StringPiece& rewrite)
+      : re_(re), rewrite_(rewrite) {}
+
+  virtual bool Rewrite(string *out, const StringPiece& text,
+                       const int *vec, int veclen) const {
+    return re_.Rewrite(out, rewrite_, text, vec, veclen);
+  }
+
+  virtual int MaxGroup() const {
+    return kMaxArgs;
+  }
+
+ private:
+  const RE& re_;
+  StringPiece rewrite_;
+};
+
 bool RE::Replace(const StringPiece& rewrite,
-                 string *str) const {
+                 string *str,
+                 int exec_options) const {
+  return Replace(StringRewriter(*this, rewrite), str, exec_options);
+}
+
+int RE::ReplaceVecSize(const Rewriter& rewriter) const {
+  // A rewriter that reads any group must see every group: pcre_exec()
+  // returns one more than the last group it could record, not the last
+  // group that matched, and Rewrite() fails for groups beyond that.  A
+  // rewriter that reads at most the whole match needs nothing else.
+  int groups = (rewriter.MaxGroup() > 0) ? capture_count_ : 0;
+  // pcre_exec() uses the ovector as workspace for back references, and
+  // allocates its own if the ovector cannot hold them all
+  if (groups < backref_max_)
+    groups = backref_max_;
+  if (groups > kMaxArgs)
+    groups = kMaxArgs;
+  return (1 + groups) * 3;
+}
+
+bool RE::Replace(const Rewriter& rewriter,
+                 string *str,
+                 int exec_options,
+                 string *scratch) const {
   int vec[kVecSize];
-  int matches = TryMatch(*str, 0, UNANCHORED, true, vec, kVecSize);
+  int matches = TryMatch(*str, 0, UNANCHORED, true, vec,
+                         ReplaceVecSize(rewriter), exec_options);
   if (matches == 0)
     return false;
 
-  string s;
-  if (!Rewrite(&s, rewrite, *str, vec, matches))
-    return false;
+  string local;
+  string& out = (scratch != NULL) ? *scratch : local;
+  out.clear();
 
   assert(vec[0] >= 0);
   assert(vec[1] >= 0);
-  str->replace(vec[0], vec[1] - vec[0], s);
+  out.append(*str, 0, vec[0]);
+  if (!rewriter.Rewrite(&out, *str, vec, matches))
+    return false;
+
+  out.append(*str, vec[1], string::npos);
+  swap(out, *str);
   return true;
 }
 
@@ -380,10 +445,23 @@ static int NewlineMode(int pcre_options) {
 
 int RE::GlobalReplace(const StringPiece& rewrite,
                       string *str,
-                      unsigned int length_limit) const {
+                      unsigned int length_limit,
+                      int exec_options) const {
+  return GlobalReplace(StringRewriter(*this, rewrite), str, length_limit,
+                       exec_options);
+}
+
+int RE::GlobalReplace(const Rewriter& rewriter,
+                      string *str,
+                      unsigned int length_limit,
+                      int exec_options,
+                      string *scratch) const {
   int count = 0;
   int vec[kVecSize];
-  string out;
+  int vecsize = ReplaceVecSize(rewriter);
+  string local;
+  string& out = (scratch != NULL) ? *scratch : local;
+  out.clear();
   int start = 0;
   bool last_match_was_empty_string = false;
 
@@ -400,7 +478,8 @@ int RE::GlobalReplace(const StringPiece& rewrite,
     //    perl -le '$_ = "aa"; s/b*|aa/@/g; print'
     int matches;
     if (last_match_was_empty_string) {
-      matches = TryMatch(*str, start, ANCHOR_START, false, vec, kVecSize);
+      matches = TryMatch(*str, start, ANCHOR_START, false, vec, vecsize,
+                         exec_options);
       if (matches <= 0) {
         int matchend = start + 1;     // advance one character.
         // If the current char is CR and we're in CRLF mode, skip LF too.
@@ -430,7 +509,8 @@ int RE::GlobalReplace(const StringPiece& rewrite,
         continue;
       }
     } else {
-      matches = TryMatch(*str, start, UNANCHORED, true, vec, kVecSize);
+      matches = TryMatch(*str, start, UNANCHORED, true, vec, vecsize,
+                         exec_options);
       if (matches <= 0)
         break;
     }
@@ -438,7 +518,7 @@ int RE::GlobalReplace(const StringPiece& rewrite,
     assert(matchstart >= start);
     assert(matchend >= matchstart);
     out.append(*str, start, matchstart - start);
-    Rewrite(&out, rewrite, *str, vec, matches);
+    rewriter.Rewrite(&out, *str, vec, matches);
     start = matchend;
     count++;
     last_match_was_empty_string = (matchstart == matchend);
@@ -505,14 +585,28 @@ int RE::TryMatch(const StringPiece& text,
                  Anchor anchor,
                  bool empty_ok,
                  int *vec,
-                 int vecsize) const {
+                 int vecsize,
+                 int exec_options) const {
   pcre* re = (anchor == ANCHOR_BOTH) ? re_full_ : re_partial_;
   if (re == NULL) {
     //fprintf(stderr, "Matching against invalid re: %s\n", error_->c_str());
     return 0;
   }
 
+  // pcre_exec() does not check the start offset either when told to skip
+  // UTF-8 validation, and starting inside a character is undefined.  Fail
+  // the match as PCRE_ERROR_BADUTF8_OFFSET would have.
+  if ((exec_options & PCRE_NO_UTF8_CHECK) && options_.utf8() &&
+      startpos < text.size() && (text[startpos] & 0xc0) == 0x80) {
+    return 0;
+  }
+
   pcre_extra extra = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  if (re == re_partial_ && extra_ != NULL) {
+    // Carries the study data and, if JIT compilation succeeded, the
+    // machine code.  pcre_exec() uses the interpreter otherwise.
+    extra = *extra_;
+  }
   if (options_.match_limit() > 0) {
     extra.flags |= PCRE_EXTRA_MATCH_LIMIT;
     extra.match_limit = options_.match_limit();
@@ -524,7 +618,7 @@ int RE::TryMatch(const StringPiece& text,
 
   // int options = 0;
   // Changed by PH as a result of bugzilla #1288
-  int options = (options_.all_options() & PCRE_NO_UTF8_CHECK);
+  int options = (options_.all_options() & PCRE_NO_UTF8_CHECK) | exec_options;
 
   if (anchor != UNANCHORED)
     options |= PCRE_ANCHORED;
@@ -614,7 +708,7 @@ bool RE::DoMatch(const StringPiece& text,
 }
 
 bool RE::Rewrite(string *out, const StringPiece &rewrite,
-                 const StringPiece &text, int *vec, int veclen) const {
+                 const StringPiece &text, const int *vec, int veclen) const {
   for (const char *s = rewrite.data(), *end = s + rewrite.size();
        s < end; s++) {
     int c = *s;
@@ -658,6 +752,24 @@ int RE::NumberOfCapturingGroups() const {
   return result;
 }
 
+size_t RE::MemoryUsage() const {
+  size_t total = 0;
+  size_t size;
+  if (re_partial_ != NULL &&
+      pcre_fullinfo(re_partial_, extra_, PCRE_INFO_SIZE, &size) == 0)
+    total += size;
+  if (re_partial_ != NULL && extra_ != NULL &&
+      pcre_fullinfo(re_partial_, extra_, PCRE_INFO_STUDYSIZE, &size) == 0)
+    total += size;
+  if (re_partial_ != NULL && extra_ != NULL &&
+      pcre_fullinfo(re_partial_, extra_, PCRE_INFO_JITSIZE, &size) == 0)
+    total += size;
+  if (re_full_ != NULL &&
+      pcre_fullinfo(re_full_, NULL, PCRE_INFO_SIZE, &size) == 0)
+    total += size;
+  return total;
+}
+
 /***** Parsers for various types *****/
 
 bool Arg::parse_null(const char* str, int n, void* dest) {
@@ -355,7 +355,8 @@ namespace pcrecpp {
 class PCRECPP_EXP_DEFN RE_Options {
  public:
   // constructor
-  RE_Options() : match_limit_(0), match_limit_recursion_(0), all_options_(0) {}
+  RE_Options() : match_limit_(0), match_limit_recursion_(0), all_options_(0),
+                 study_(false), jit_(false), full_match_(true) {}
 
   // alternative constructor.
   // To facilitate transfer of legacy code from C programs
@@ -366,7 +367,8 @@ class PCRECPP_EXP_DEFN RE_Options {
   //    RE(pattern,
   //      RE_Options().set_caseless(true).set_multiline(true)).PartialMatch(str);
   RE_Options(int option_flags) : match_limit_(0), match_limit_recursion_(0),
-                                 all_options_(option_flags) {}
+                                 all_options_(option_flags), study_(false),
+                                 jit_(false), full_match_(true) {}
   // we're fine with the default destructor, copy constructor, etc.
 
   // accessors and mutators
@@ -382,6 +384,34 @@ class PCRECPP_EXP_DEFN RE_Options {
     return *this;
   }
 
+  // Study the compiled pattern with pcre_study() and keep the result for
+  // every match, so that pcre_exec() can use the start-byte bitmap and the
+  // minimum subject length.
+  bool study() const { return study_; }
+  RE_Options &set_study(bool x) {
+    study_ = x;
+    return *this;
+  }
+
+  // Study the compiled pattern with PCRE_STUDY_JIT_COMPILE.  If the library
+  // was built without JIT support, or JIT compilation of this particular
+  // pattern fails, matching falls back to the interpreter.
+  bool jit() const { return jit_; }
+  RE_Options &set_jit(bool x) {
+    jit_ = x;
+    return *this;
+  }
+
+  // Compile the "(?:...)\z" copy of the pattern used by FullMatch().  Users
+  // that only ever call PartialMatch(), Replace(), GlobalReplace() etc. can
+  // turn this off to halve compile time and memory; FullMatch() then never
+  // matches.
+  bool full_match() const { return full_match_; }
+  RE_Options &set_full_match(bool x) {
+    full_match_ = x;
+    return *this;
+  }
+
   bool caseless() const {
     return PCRE_IS_SET(PCRE_CASELESS);
   }
@@ -459,6 +489,9 @@ class PCRECPP_EXP_DEFN RE_Options {
   int match_limit_;
   int match_limit_recursion_;
   int all_options_;
+  bool study_;
+  bool jit_;
+  bool full_match_;
 };
 
 // These functions return some common RE_Options
@@ -499,6 +532,13 @@ class PCRECPP_EXP_DEFN RE {
     Init(reinterpret_cast<const char*>(pat), &option);
   }
 
+  // Wrap an already compiled (unanchored) form of "pat", for example one
+  // loaded back from disk.  The RE takes ownership of "compiled", which must
+  // have been allocated with pcre_malloc and already be in host byte order.
+  RE(const string& pat, const RE_Options& option, pcre* compiled) {
+    Init(pat, &option, compiled);
+  }
+
   // Copy constructor & assignment - note that these are expensive
   // because they recompile the expression.
   RE(const RE& re) { Init(re.pattern_, &re.options_); }
@@ -527,6 +567,12 @@ class PCRECPP_EXP_DEFN RE {
   // Else returns the empty string.
   const string& error() const { return *error_; }
 
+  // The compiled unanchored pattern, or NULL if the RE is invalid.
+  const pcre* compiled() const { return re_partial_; }
+
+  // The study data for compiled(), or NULL if it was not studied.
+  const pcre_extra* extra() const { return extra_; }
+
   /***** The useful part: the matching interface *****/
 
   // This is provided so one can do pattern.ReplaceAll() just as
@@ -604,12 +650,51 @@ class PCRECPP_EXP_DEFN RE {
                       const Arg& ptr15 = no_arg,
                       const Arg& ptr16 = no_arg) const;
 
+  // exec_options are passed on to every pcre_exec() call, e.g.
+  // PCRE_NO_UTF8_CHECK when the caller has already validated "str".
   bool Replace(const StringPiece& rewrite,
-               string *str) const;
+               string *str,
+               int exec_options = 0) const;
 
   int GlobalReplace(const StringPiece& rewrite,
                     string *str,
-                    unsigned int length_limit) const;
+                    unsigned int length_limit,
+                    int exec_options = 0) const;
+
+  // Produces the replacement text for each match, for callers that keep
+  // their rewrite string in a form that is cheaper to apply than
+  // re-parsing it on every match.
+  class Rewriter {
+   public:
+    virtual ~Rewriter() {}
+
+    // Appends the replacement for one match to "out".  "vec" holds
+    // "veclen" pairs of offsets into "text", as for Rewrite() below.
+    // Returns false if the replacement is invalid.
+    virtual bool Rewrite(string *out,
+                         const StringPiece& text,
+                         const int *vec,
+                         int veclen) const = 0;
+
+    // Highest group that Rewrite() reads.  If it is 0 or less, Replace()
+    // and GlobalReplace() only ask pcre_exec() for the offsets of the
+    // whole match.
+    virtual int MaxGroup() const = 0;
+  };
+
+  // If "scratch" is given, the result is built there and then swapped
+  // with "str", so a caller that keeps both strings around can reuse
+  // their storage instead of allocating a new string for every call.
+  bool Replace(const Rewriter& rewriter,
+               string *str,
+               int exec_options = 0,
+               string *scratch = NULL) const;
+
+  int GlobalReplace(const Rewriter& rewriter,
+                    string *str,
+                    unsigned int length_limit,
+                    int exec_options = 0,
+                    string *scratch = NULL) const;
 
   bool Extract(const StringPiece &rewrite,
                const StringPiece &text,
@@ -647,6 +732,10 @@ class PCRECPP_EXP_DEFN RE {
   // regexp wasn't valid on construction.
   int NumberOfCapturingGroups() const;
 
+  // Return the number of bytes used by the compiled patterns, their study
+  // data and any JIT compiled code.
+  size_t MemoryUsage() const;
+
   // The default value for an argument, to indicate the end of the argument
   // list. This must be used only in optional argument defaults. It should NOT
   // be passed explicitly. Some people have tried to use it like this:
@@ -658,7 +747,8 @@ class PCRECPP_EXP_DEFN RE {
 
  private:
 
-  void Init(const string& pattern, const RE_Options* options);
+  void Init(const string& pattern, const RE_Options* options,
+            pcre* compiled = NULL);
   void Cleanup();
 
   // Match against "text", filling in "vec" (up to "vecsize" * 2/3) with
@@ -677,16 +767,21 @@ class PCRECPP_EXP_DEFN RE {
                Anchor anchor,
                bool empty_ok,
                int *vec,
-               int vecsize) const;
+               int vecsize,
+               int exec_options = 0) const;
 
   // Append the "rewrite" string, with backslash subsitutions from "text"
   // and "vec", to string "out".
   bool Rewrite(string *out,
                const StringPiece& rewrite,
                const StringPiece& text,
-               int *vec,
+               const int *vec,
                int veclen) const;
 
+  // Rewriter that parses a rewrite string on every call, for the
+  // StringPiece versions of Replace() and GlobalReplace()
+  class StringRewriter;
+
   // internal implementation for DoMatch
   bool DoMatchImpl(const StringPiece& text,
                    Anchor anchor,
@@ -696,6 +791,9 @@ class PCRECPP_EXP_DEFN RE {
                    int* vec,
                    int vecsize) const;
 
+  // Size of the ovector to pass to TryMatch() for "rewriter"
+  int ReplaceVecSize(const Rewriter& rewriter) const;
+
   // Compile the regexp for the specified anchoring mode
   pcre* Compile(Anchor anchor);
 
@@ -703,6 +801,9 @@ class PCRECPP_EXP_DEFN RE {
   RE_Options    options_;
   pcre*         re_full_;       // For full matches
   pcre*         re_partial_;    // For partial matches
+  pcre_extra*   extra_;         // Study data for re_partial_ (or NULL)
+  int           backref_max_;   // Highest back reference in the pattern
+  int           capture_count_; // Number of capturing groups
   const string* error_;         // Error indicator (or points to empty string)
 };
 
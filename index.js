@@ -1 +1,46 @@
-module.exports = require('./build/Release/cytubefilters');
+var FilterList = require('./build/Release/cytubefilters');
+
+// The native methods take a node-style callback as their fourth argument.
+// Without one, these return a Promise instead.
+function withPromise(name) {
+    return function () {
+        var args = Array.prototype.slice.call(arguments);
+        var callback = null;
+        if (typeof args[args.length - 1] === 'function') {
+            callback = args.pop();
+        }
+
+        var self = this;
+        function run(done) {
+            self[name](args[0], args[1], args[2], done);
+        }
+
+        if (callback) {
+            run(callback);
+            return;
+        }
+
+        // Started outside the executor so that bad arguments still throw
+        var resolve, reject;
+        var promise = new Promise(function (res, rej) {
+            resolve = res;
+            reject = rej;
+        });
+
+        run(function (err, result) {
+            if (err) {
+                reject(err);
+            } else {
+                resolve(result);
+            }
+        });
+
+        return promise;
+    };
+}
+
+FilterList.prototype.filterAsync = withPromise('_filterAsync');
+FilterList.prototype.filterManyAsync = withPromise('_filterManyAsync');
+FilterList.prototype.filterManyParallel = withPromise('_filterManyParallel');
+
+module.exports = FilterList;
@@ -0,0 +1,155 @@
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "./ahocorasick.h"
+
+static unsigned char FoldByte(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (c | 0x20) : c;
+}
+
+AhoCorasick::AhoCorasick(bool fold) : m_Fold(fold), m_NumClasses(1)
+{
+    memset(this->m_Classes, 0, sizeof(this->m_Classes));
+}
+
+void AhoCorasick::add(const std::string& needle, unsigned int id)
+{
+    if (needle.empty()) return;
+
+    std::string stored = needle;
+    if (this->m_Fold)
+    {
+        for (size_t i = 0; i < stored.size(); i++)
+        {
+            stored[i] = FoldByte(stored[i]);
+        }
+    }
+
+    this->m_Needles.push_back(std::make_pair(stored, id));
+}
+
+void AhoCorasick::clear()
+{
+    this->m_Needles.clear();
+    this->m_Transitions.clear();
+    this->m_OutputStart.clear();
+    this->m_Outputs.clear();
+    this->m_NumClasses = 1;
+    memset(this->m_Classes, 0, sizeof(this->m_Classes));
+}
+
+bool AhoCorasick::empty() const
+{
+    return this->m_Transitions.empty();
+}
+
+size_t AhoCorasick::memory_usage() const
+{
+    return this->m_Transitions.capacity() * sizeof(uint32_t) +
+        this->m_OutputStart.capacity() * sizeof(uint32_t) +
+        this->m_Outputs.capacity() * sizeof(unsigned int);
+}
+
+void AhoCorasick::build()
+{
+    this->m_Transitions.clear();
+    this->m_OutputStart.clear();
+    this->m_Outputs.clear();
+    memset(this->m_Classes, 0, sizeof(this->m_Classes));
+    this->m_NumClasses = 1;
+
+    if (this->m_Needles.empty()) return;
+
+    // Every distinct needle byte gets its own class
+    for (size_t n = 0; n < this->m_Needles.size(); n++)
+    {
+        const std::string& needle = this->m_Needles[n].first;
+        for (size_t i = 0; i < needle.size(); i++)
+        {
+            unsigned char c = needle[i];
+            if (this->m_Classes[c] == 0)
+            {
+                this->m_Classes[c] = this->m_NumClasses++;
+            }
+        }
+    }
+
+    if (this->m_Fold)
+    {
+        for (int c = 'A'; c <= 'Z'; c++)
+        {
+            this->m_Classes[c] = this->m_Classes[c | 0x20];
+        }
+    }
+
+    // Build the trie; 0 doubles as "no edge" since nothing points back at
+    // the root
+    const uint32_t classes = this->m_NumClasses;
+    std::vector<uint32_t>& next = this->m_Transitions;
+    std::vector<std::vector<unsigned int> > outputs(1);
+    next.assign(classes, 0);
+
+    for (size_t n = 0; n < this->m_Needles.size(); n++)
+    {
+        const std::string& needle = this->m_Needles[n].first;
+        uint32_t state = 0;
+        for (size_t i = 0; i < needle.size(); i++)
+        {
+            uint32_t cls = this->m_Classes[static_cast<unsigned char>(needle[i])];
+            if (next[state * classes + cls] == 0)
+            {
+                next[state * classes + cls] = outputs.size();
+                outputs.push_back(std::vector<unsigned int>());
+                next.resize(next.size() + classes, 0);
+            }
+
+            state = next[state * classes + cls];
+        }
+
+        outputs[state].push_back(this->m_Needles[n].second);
+    }
+
+    // Breadth-first, turn the trie into a DFA by pointing missing edges at
+    // the failure state's edges, and inherit the failure state's outputs
+    std::vector<uint32_t> fail(outputs.size(), 0);
+    std::deque<uint32_t> queue;
+    for (uint32_t cls = 0; cls < classes; cls++)
+    {
+        if (next[cls] != 0) queue.push_back(next[cls]);
+    }
+
+    while (!queue.empty())
+    {
+        uint32_t state = queue.front();
+        queue.pop_front();
+
+        const std::vector<unsigned int>& inherited = outputs[fail[state]];
+        outputs[state].insert(outputs[state].end(), inherited.begin(), inherited.end());
+
+        for (uint32_t cls = 0; cls < classes; cls++)
+        {
+            uint32_t child = next[state * classes + cls];
+            if (child != 0)
+            {
+                fail[child] = next[fail[state] * classes + cls];
+                queue.push_back(child);
+            }
+            else
+            {
+                next[state * classes + cls] = next[fail[state] * classes + cls];
+            }
+        }
+    }
+
+    this->m_OutputStart.reserve(outputs.size() + 1);
+    for (size_t state = 0; state < outputs.size(); state++)
+    {
+        this->m_OutputStart.push_back(this->m_Outputs.size());
+        this->m_Outputs.insert(this->m_Outputs.end(), outputs[state].begin(), outputs[state].end());
+    }
+
+    this->m_OutputStart.push_back(this->m_Outputs.size());
+}
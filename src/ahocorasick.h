@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Multi-pattern substring search.  Needles are compiled into a DFA over
+// byte equivalence classes, so a scan costs one table lookup per input byte
+// regardless of how many needles there are.
+class AhoCorasick
+{
+    public:
+        // If fold is set, ASCII letters in both the needles and the scanned
+        // text are compared case-insensitively.
+        explicit AhoCorasick(bool fold = false);
+
+        void add(const std::string& needle, unsigned int id);
+        void build();
+        void clear();
+
+        bool empty() const;
+        size_t memory_usage() const;
+
+        // Calls on_match(end, id) for every occurrence of every needle in
+        // data, in order of end position, where end is the offset one past
+        // the last byte of the occurrence.  Stops early if on_match returns
+        // false.
+        template<typename Callback>
+        void scan(const char *data, size_t length, Callback on_match) const
+        {
+            if (this->m_Transitions.empty()) return;
+
+            const unsigned char *p = reinterpret_cast<const unsigned char*>(data);
+            uint32_t state = 0;
+            for (size_t i = 0; i < length; i++)
+            {
+                state = this->m_Transitions[state * this->m_NumClasses + this->m_Classes[p[i]]];
+
+                uint32_t out = this->m_OutputStart[state];
+                uint32_t out_end = this->m_OutputStart[state + 1];
+                for (; out < out_end; out++)
+                {
+                    if (!on_match(i + 1, this->m_Outputs[out])) return;
+                }
+            }
+        }
+
+    private:
+        bool m_Fold;
+        std::vector<std::pair<std::string, unsigned int> > m_Needles;
+
+        // Maps each input byte to its equivalence class; bytes that occur in
+        // no needle all share class 0, so there can be 257 classes
+        uint16_t m_Classes[256];
+        uint32_t m_NumClasses;
+        std::vector<uint32_t> m_Transitions;
+        // Needles ending at each state (including through failure links) are
+        // m_Outputs[m_OutputStart[state] .. m_OutputStart[state + 1]]
+        std::vector<uint32_t> m_OutputStart;
+        std::vector<unsigned int> m_Outputs;
+};
@@ -0,0 +1,54 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "./allocations.h"
+
+#ifdef DEBUG
+
+static std::atomic<uint64_t> s_Count(0);
+
+// Debug builds link with -Bsymbolic (see binding.gyp), so calls from this
+// module bind to these definitions while the rest of the process keeps its
+// own.  Memory is still freed by the usual operator delete, which calls
+// free().
+void* operator new(size_t size)
+{
+    s_Count.fetch_add(1, std::memory_order_relaxed);
+
+    void *p = malloc(size > 0 ? size : 1);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+#endif
+
+namespace Allocations
+{
+    bool Counted()
+    {
+#ifdef DEBUG
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    uint64_t Count()
+    {
+#ifdef DEBUG
+        return s_Count.load(std::memory_order_relaxed);
+#else
+        return 0;
+#endif
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// Counts the operator new calls made by code in this module.  Only debug
+// builds count, so that tests can check that filtering a message allocates
+// nothing once the reusable buffers have grown.
+namespace Allocations
+{
+    // False in release builds, where Count() is always 0
+    bool Counted();
+    uint64_t Count();
+}
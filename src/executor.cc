@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "./executor.h"
+
+// Queued tasks before submit starts running them on the calling thread
+#define EXECUTOR_QUEUE_CAPACITY 65536
+
+typedef std::chrono::steady_clock Clock;
+
+static uint64_t NanosecondsSince(const Clock::time_point& start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - start).count();
+}
+
+// Never destroyed, like the pattern cache: the threads would otherwise have
+// to be joined while static destructors run at exit
+Executor& Executor::Get()
+{
+    static Executor *executor = new Executor(
+        std::max(1u, std::thread::hardware_concurrency()), EXECUTOR_QUEUE_CAPACITY);
+    return *executor;
+}
+
+Executor::Executor(size_t threads, size_t capacity)
+    : m_Queue(capacity),
+    m_Started(Clock::now()),
+    m_Depth(0),
+    m_Sleeping(0),
+    m_Stopping(false),
+    m_Completed(0),
+    m_LatencyTotalNs(0),
+    m_LatencyMaxNs(0)
+{
+    for (size_t i = 0; i < threads; i++)
+    {
+        Worker *worker = new Worker();
+        worker->busy_ns.store(0);
+        this->m_Workers.push_back(std::unique_ptr<Worker>(worker));
+        worker->thread = std::thread(&Executor::work, this, worker);
+    }
+}
+
+// Runs whatever is still queued, then stops the threads
+Executor::~Executor()
+{
+    {
+        std::lock_guard<std::mutex> lock(this->m_Mutex);
+        this->m_Stopping.store(true);
+    }
+
+    this->m_Wake.notify_all();
+    for (size_t i = 0; i < this->m_Workers.size(); i++)
+    {
+        this->m_Workers[i]->thread.join();
+    }
+}
+
+void Executor::submit(Task *task)
+{
+    task->m_Submitted = Clock::now();
+    if (!this->m_Queue.push(task))
+    {
+        this->finish(task);
+        return;
+    }
+
+    // Pairs with the check in work(): either a sleeping thread is counted
+    // here and woken, or it sees the new depth before going to sleep
+    this->m_Depth.fetch_add(1);
+    if (this->m_Sleeping.load() > 0)
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->m_Mutex);
+        }
+
+        this->m_Wake.notify_one();
+    }
+}
+
+void Executor::finish(Task *task)
+{
+    task->run();
+
+    uint64_t latency = NanosecondsSince(task->m_Submitted);
+    uint64_t max = this->m_LatencyMaxNs.load();
+    while (latency > max && !this->m_LatencyMaxNs.compare_exchange_weak(max, latency))
+    {
+    }
+
+    // In the reverse of the order stats() reads them in, so that its mean
+    // never exceeds its maximum while tasks are finishing
+    this->m_Completed.fetch_add(1);
+    this->m_LatencyTotalNs.fetch_add(latency);
+
+    task->done();
+}
+
+void Executor::work(Worker *worker)
+{
+    for (;;)
+    {
+        Task *task;
+        if (this->m_Queue.pop(task))
+        {
+            this->m_Depth.fetch_sub(1);
+
+            Clock::time_point start = Clock::now();
+            this->finish(task);
+            worker->busy_ns.fetch_add(NanosecondsSince(start));
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(this->m_Mutex);
+        this->m_Sleeping.fetch_add(1);
+        while (this->m_Depth.load() <= 0 && !this->m_Stopping.load())
+        {
+            this->m_Wake.wait(lock);
+        }
+        this->m_Sleeping.fetch_sub(1);
+
+        if (this->m_Depth.load() <= 0 && this->m_Stopping.load())
+        {
+            return;
+        }
+    }
+}
+
+Executor::Stats Executor::stats() const
+{
+    Stats stats;
+    stats.threads = this->m_Workers.size();
+    stats.queue_depth = std::max(0L, this->m_Depth.load());
+
+    uint64_t total = this->m_LatencyTotalNs.load();
+    stats.completed = this->m_Completed.load();
+    stats.mean_latency = stats.completed > 0 ?
+        static_cast<double>(total / stats.completed) / 1000.0 : 0;
+    stats.max_latency = this->m_LatencyMaxNs.load() / 1000.0;
+
+    double elapsed = static_cast<double>(NanosecondsSince(this->m_Started));
+    for (size_t i = 0; i < this->m_Workers.size(); i++)
+    {
+        double busy = static_cast<double>(this->m_Workers[i]->busy_ns.load());
+        stats.utilisation.push_back(elapsed > 0 ? std::min(1.0, busy / elapsed) : 0);
+    }
+
+    return stats;
+}
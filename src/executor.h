@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "./mpmcqueue.h"
+
+// Fixed pool of native threads running tasks from a shared lock-free queue.
+// Unlike the libuv threadpool, which node shares with file system and DNS
+// work, the pool is only used for filtering and is sized to the machine.
+class Executor
+{
+    public:
+        class Task
+        {
+            public:
+                virtual ~Task() {}
+                // Called on a pool thread
+                virtual void run() = 0;
+                // Called after run, once the executor has counted the task
+                // in its stats, so completion should be published here
+                // rather than in run.  The task is not deleted by the
+                // executor and may be deleted by done itself.
+                virtual void done() {}
+
+            private:
+                friend class Executor;
+                std::chrono::steady_clock::time_point m_Submitted;
+        };
+
+        struct Stats
+        {
+            size_t threads;
+            size_t queue_depth;
+            uint64_t completed;
+            // Time from submit until run returned, in microseconds
+            double mean_latency;
+            double max_latency;
+            // Fraction of the time since the executor started that each
+            // thread spent running tasks
+            std::vector<double> utilisation;
+        };
+
+        // Process-wide executor with one thread per core, started on first
+        // use and never stopped
+        static Executor& Get();
+
+        Executor(size_t threads, size_t capacity);
+        ~Executor();
+
+        // If the queue is full the task is run right away on the calling
+        // thread instead, which slows producers down to the pool's pace
+        void submit(Task *task);
+        Stats stats() const;
+
+    private:
+        struct Worker
+        {
+            std::thread thread;
+            std::atomic<uint64_t> busy_ns;
+        };
+
+        void work(Worker *worker);
+        void finish(Task *task);
+
+        MpmcQueue<Task*> m_Queue;
+        std::vector<std::unique_ptr<Worker> > m_Workers;
+        std::chrono::steady_clock::time_point m_Started;
+
+        // Only used to put idle threads to sleep; producers take the lock
+        // just to wake one up
+        std::mutex m_Mutex;
+        std::condition_variable m_Wake;
+        std::atomic<long> m_Depth;
+        std::atomic<size_t> m_Sleeping;
+        std::atomic<bool> m_Stopping;
+
+        std::atomic<uint64_t> m_Completed;
+        std::atomic<uint64_t> m_LatencyTotalNs;
+        std::atomic<uint64_t> m_LatencyMaxNs;
+};
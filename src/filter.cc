@@ -1,10 +1,19 @@
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 #include <pcrecpp.h>
 
 #include "./filter.h"
+#include "./literal.h"
+#include "./pattern.h"
+#include "./patterncache.h"
+#include "./wordlist.h"
 
-#define MATCH_LIMIT 5000
-
-Filter::Filter() : m_RE(NULL)
+Filter::Filter() : m_Global(false),
+    m_Active(false),
+    m_FilterLinks(false),
+    m_Flags(DEFAULT_FLAGS)
 {
 }
 
@@ -15,49 +24,89 @@ Filter::Filter(const std::string& name,
     bool active,
     bool filter_links)
     : m_Replacement(replacement),
+    m_Rewrite(replacement),
     m_Name(name),
     m_Global(false),
     m_Active(active),
-    m_FilterLinks(filter_links)
+    m_FilterLinks(filter_links),
+    m_Flags(DEFAULT_FLAGS)
 {
     this->set_flags(flags);
-    pcrecpp::RE_Options options(this->m_Flags);
-    options.set_match_limit(MATCH_LIMIT);
+    this->compile(source);
+}
 
-    this->m_RE = new pcrecpp::RE(source, options);
+Filter::Filter(const std::string& name,
+    const std::vector<std::string>& words,
+    const std::string& flags,
+    WordList::Boundary boundary,
+    const std::string& replacement,
+    bool active,
+    bool filter_links)
+    : m_Replacement(replacement),
+    m_Rewrite(replacement),
+    m_Name(name),
+    m_Global(false),
+    m_Active(active),
+    m_FilterLinks(filter_links),
+    m_Flags(DEFAULT_FLAGS)
+{
+    this->set_flags(flags);
+    this->compile_words(words, boundary);
 }
 
-Filter::Filter(const Filter& copy) : m_Replacement(copy.m_Replacement),
-    m_Name(copy.m_Name),
-    m_Global(copy.m_Global),
-    m_Active(copy.m_Active),
-    m_FilterLinks(copy.m_FilterLinks)
+// True if source may refer to a capturing group by number, e.g. \1, \g{-1},
+// (?1) or (?(1)...).  Errs on the side of true.
+static bool MayReferToGroupNumbers(const std::string& source)
 {
-    this->m_Flags = copy.m_Flags;
-    pcrecpp::RE_Options options(this->m_Flags);
-    options.set_match_limit(MATCH_LIMIT);
-    this->m_RE = new pcrecpp::RE(copy.m_RE->pattern(), options);
+    for (size_t i = 0; i + 1 < source.size(); i++)
+    {
+        char next = source[i + 1];
+        if (source[i] == '\\')
+        {
+            if ((next >= '1' && next <= '9') || next == 'g')
+            {
+                return true;
+            }
+
+            i++;
+        }
+        else if (source[i] == '(' && next == '?' && i + 2 < source.size())
+        {
+            char c = source[i + 2];
+            if ((c >= '0' && c <= '9') || c == '+' || c == '-' || c == '(')
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
 }
 
-Filter& Filter::operator=(const Filter& rhs)
+// PCRE_NO_AUTO_CAPTURE saves pcre_exec from recording groups that nothing
+// reads: the replacement uses at most the whole match, and the pattern
+// does not depend on how its groups are numbered
+int Filter::compile_flags(const std::string& source) const
 {
-    this->m_Replacement = rhs.m_Replacement;
-    this->m_Name = rhs.m_Name;
-    this->m_Global = rhs.m_Global;
-    this->m_Active = rhs.m_Active;
-    this->m_FilterLinks = rhs.m_FilterLinks;
+    if (this->m_Rewrite.MaxGroup() < 1 && !MayReferToGroupNumbers(source))
+    {
+        return this->m_Flags | PCRE_NO_AUTO_CAPTURE;
+    }
+
+    return this->m_Flags;
+}
 
-    delete this->m_RE;
-    this->m_Flags = rhs.m_Flags;
-    pcrecpp::RE_Options options(this->m_Flags);
-    options.set_match_limit(MATCH_LIMIT);
-    this->m_RE = new pcrecpp::RE(rhs.m_RE->pattern(), options);
-    return *this;
+void Filter::compile(const std::string& source)
+{
+    this->m_Pattern = PatternCache::Get(source, this->compile_flags(source));
+    this->m_WordList.reset();
 }
 
-Filter::~Filter()
+void Filter::compile_words(const std::vector<std::string>& words, WordList::Boundary boundary)
 {
-    if (this->m_RE != NULL) delete this->m_RE;
+    this->m_WordList = std::make_shared<const WordList>(words,
+        (this->m_Flags & PCRE_CASELESS) != 0, boundary);
+    this->m_Pattern.reset();
 }
 
 const std::string& Filter::name() const
@@ -67,15 +116,37 @@ const std::string& Filter::name() const
 
 const std::string& Filter::source() const
 {
-    return this->m_RE->pattern();
+    static const std::string empty;
+    return this->m_Pattern ? this->m_Pattern->source() : empty;
 }
 
 void Filter::set_source(const std::string& source)
 {
-    delete this->m_RE;
-    pcrecpp::RE_Options options(this->m_Flags);
-    options.set_match_limit(MATCH_LIMIT);
-    this->m_RE = new pcrecpp::RE(source, options);
+    this->compile(source);
+}
+
+const WordList* Filter::word_list() const
+{
+    return this->m_WordList.get();
+}
+
+void Filter::set_words(const std::vector<std::string>& words)
+{
+    WordList::Boundary boundary = WordList::BOUNDARY_WORD;
+    if (this->m_WordList)
+    {
+        boundary = this->m_WordList->boundary();
+    }
+
+    this->compile_words(words, boundary);
+}
+
+void Filter::set_boundary(WordList::Boundary boundary)
+{
+    if (this->m_WordList && this->m_WordList->boundary() != boundary)
+    {
+        this->compile_words(this->m_WordList->words(), boundary);
+    }
 }
 
 const std::string& Filter::replacement() const
@@ -86,6 +157,18 @@ const std::string& Filter::replacement() const
 void Filter::set_replacement(const std::string& replacement)
 {
     this->m_Replacement = replacement;
+    this->m_Rewrite = Replacement(replacement);
+
+    const Pattern *pattern = this->m_Pattern.get();
+    if (pattern && this->compile_flags(pattern->source()) != pattern->flags())
+    {
+        this->compile(pattern->source());
+    }
+}
+
+const Replacement& Filter::rewrite() const
+{
+    return this->m_Rewrite;
 }
 
 std::string Filter::flags() const
@@ -100,6 +183,7 @@ std::string Filter::flags() const
 
 void Filter::set_flags(const std::string& flags)
 {
+    int old_flags = this->m_Flags;
     this->m_Flags = DEFAULT_FLAGS;
     for (size_t i = 0; i < flags.size(); i++)
     {
@@ -116,6 +200,20 @@ void Filter::set_flags(const std::string& flags)
                 break;
         }
     }
+
+    if (this->m_Pattern && this->m_Flags != old_flags)
+    {
+        this->compile(this->m_Pattern->source());
+    }
+    else if (this->m_WordList && this->m_Flags != old_flags)
+    {
+        this->compile_words(this->m_WordList->words(), this->m_WordList->boundary());
+    }
+}
+
+bool Filter::global() const
+{
+    return this->m_Global;
 }
 
 bool Filter::active() const
@@ -138,14 +236,196 @@ void Filter::set_filter_links(bool filter_links)
     this->m_FilterLinks = filter_links;
 }
 
-bool Filter::exec(std::string* input, unsigned int length_limit) const
+bool Filter::operator==(const Filter& rhs) const
+{
+    if (this->name() != rhs.name() || this->source() != rhs.source() ||
+        this->flags() != rhs.flags() || this->replacement() != rhs.replacement() ||
+        this->active() != rhs.active() || this->filter_links() != rhs.filter_links())
+    {
+        return false;
+    }
+
+    const WordList *words = this->word_list();
+    const WordList *rhs_words = rhs.word_list();
+    if (words == NULL || rhs_words == NULL)
+    {
+        return words == rhs_words;
+    }
+
+    return words->words() == rhs_words->words() &&
+        words->boundary() == rhs_words->boundary();
+}
+
+const Pattern* Filter::pattern() const
+{
+    return this->m_Pattern.get();
+}
+
+size_t Filter::memory_usage() const
 {
+    if (this->m_WordList)
+    {
+        return this->m_WordList->memory_usage();
+    }
+
+    return this->m_Pattern->memory_usage();
+}
+
+bool Filter::exec(std::string* input, unsigned int length_limit,
+    int exec_options, bool ascii, std::string* scratch) const
+{
+    std::string local;
+    if (scratch == NULL)
+    {
+        scratch = &local;
+    }
+
+    if (this->m_WordList)
+    {
+        return this->exec_words(input, length_limit, scratch);
+    }
+
+    if (!this->m_Pattern->may_match(*input))
+    {
+        return false;
+    }
+
+    // Searching for a literal is only equivalent once the caller has
+    // checked that the input is valid UTF-8, which PCRE would require
+    const Pattern& pattern = *this->m_Pattern;
+    if (pattern.literal() != NULL && (exec_options & PCRE_NO_UTF8_CHECK) &&
+        (ascii || !pattern.literal_needs_ascii()))
+    {
+        return this->exec_literal(input, length_limit, scratch);
+    }
+
+    const pcrecpp::RE *re = &this->m_Pattern->re();
+    if (ascii && this->m_Pattern->ascii_re() != NULL)
+    {
+        re = this->m_Pattern->ascii_re();
+    }
+
     if (this->m_Global)
     {
-        return this->m_RE->GlobalReplace(this->m_Replacement, input, length_limit);
+        return re->GlobalReplace(this->m_Rewrite, input, length_limit,
+            exec_options, scratch);
     }
     else
     {
-        return this->m_RE->Replace(this->m_Replacement, input);
+        return re->Replace(this->m_Rewrite, input, exec_options, scratch);
     }
 }
+
+// Replace and GlobalReplace for a pattern that is one fixed string, with
+// the same results, including when to stop at length_limit
+bool Filter::exec_literal(std::string* input, unsigned int length_limit,
+    std::string* out) const
+{
+    const std::string& needle = *this->m_Pattern->literal();
+    bool caseless = (this->m_Flags & PCRE_CASELESS) != 0;
+    int vec[2];
+
+    if (!this->m_Global)
+    {
+        size_t pos = Literal::Find(*input, 0, needle, caseless);
+        if (pos == std::string::npos)
+        {
+            return false;
+        }
+
+        vec[0] = pos;
+        vec[1] = pos + needle.size();
+        out->assign(*input, 0, pos);
+        if (!this->m_Rewrite.append(out, input->data(), vec, 1))
+        {
+            return false;
+        }
+
+        out->append(*input, vec[1], std::string::npos);
+        input->swap(*out);
+        return true;
+    }
+
+    if (input->length() >= length_limit)
+    {
+        return false;
+    }
+
+    out->clear();
+    size_t start = 0;
+    bool matched = false;
+    while (out->length() < length_limit)
+    {
+        size_t pos = Literal::Find(*input, start, needle, caseless);
+        if (pos == std::string::npos)
+        {
+            break;
+        }
+
+        vec[0] = pos;
+        vec[1] = pos + needle.size();
+        out->append(*input, start, pos - start);
+        this->m_Rewrite.append(out, input->data(), vec, 1);
+        start = pos + needle.size();
+        matched = true;
+    }
+
+    if (!matched)
+    {
+        return false;
+    }
+
+    out->append(*input, start, std::string::npos);
+    input->swap(*out);
+    return true;
+}
+
+// Replaces the leftmost-longest occurrences of any word, stopping at
+// length_limit the same way GlobalReplace does
+bool Filter::exec_words(std::string* input, unsigned int length_limit,
+    std::string* out) const
+{
+    if (this->m_Global && input->length() >= length_limit)
+    {
+        return false;
+    }
+
+    static thread_local std::vector<std::pair<size_t, size_t> > matches;
+    matches.clear();
+    this->m_WordList->find(*input, &matches);
+    if (matches.empty())
+    {
+        return false;
+    }
+
+    int vec[2];
+    if (!this->m_Global)
+    {
+        vec[0] = matches[0].first;
+        vec[1] = matches[0].first + matches[0].second;
+        out->assign(*input, 0, vec[0]);
+        if (!this->m_Rewrite.append(out, input->data(), vec, 1))
+        {
+            return false;
+        }
+
+        out->append(*input, vec[1], std::string::npos);
+        input->swap(*out);
+        return true;
+    }
+
+    out->clear();
+    size_t start = 0;
+    for (size_t i = 0; i < matches.size() && out->length() < length_limit; i++)
+    {
+        vec[0] = matches[i].first;
+        vec[1] = matches[i].first + matches[i].second;
+        out->append(*input, start, matches[i].first - start);
+        this->m_Rewrite.append(out, input->data(), vec, 1);
+        start = vec[1];
+    }
+
+    out->append(*input, start, std::string::npos);
+    input->swap(*out);
+    return true;
+}
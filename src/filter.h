@@ -1,7 +1,14 @@
 #pragma once
 
+#include <memory>
+#include <string>
+#include <vector>
 #include <pcrecpp.h>
 
+#include "./pattern.h"
+#include "./replacement.h"
+#include "./wordlist.h"
+
 #define DEFAULT_FLAGS PCRE_UTF8 | PCRE_JAVASCRIPT_COMPAT
 
 class Filter
@@ -14,21 +21,44 @@ class Filter
             const std::string& replacement,
             bool active,
             bool filter_links);
-        Filter(const Filter& copy);
-        ~Filter();
+        // A word list filter, which replaces any of words instead of matches
+        // of a regex
+        Filter(const std::string& name,
+            const std::vector<std::string>& words,
+            const std::string& flags,
+            WordList::Boundary boundary,
+            const std::string& replacement,
+            bool active,
+            bool filter_links);
+        Filter(const Filter& copy) = default;
+        Filter(Filter&& other) = default;
+
+        Filter& operator=(const Filter& rhs) = default;
+        Filter& operator=(Filter&& rhs) = default;
 
-        Filter& operator=(const Filter& rhs);
+        // True if both filters were made from the same fields
+        bool operator==(const Filter& rhs) const;
 
         const std::string& name() const;
 
+        // Empty for word list filters.  Setting a source turns a word list
+        // filter into a regex filter.
         const std::string& source() const;
         void set_source(const std::string& source);
 
+        // NULL for regex filters.  Setting the words turns a regex filter
+        // into a word list filter.
+        const WordList* word_list() const;
+        void set_words(const std::vector<std::string>& words);
+        void set_boundary(WordList::Boundary boundary);
+
         const std::string& replacement() const;
         void set_replacement(const std::string& replacement);
+        const Replacement& rewrite() const;
 
         std::string flags() const;
         void set_flags(const std::string& flags);
+        bool global() const;
 
         bool active() const;
         void set_active(bool active);
@@ -36,11 +66,32 @@ class Filter
         bool filter_links() const;
         void set_filter_links(bool filter_links);
 
-        bool exec(std::string* input, unsigned int length_limit) const;
+        size_t memory_usage() const;
+        // NULL for word list filters
+        const Pattern* pattern() const;
+
+        // exec_options are passed on to pcre_exec, e.g. PCRE_NO_UTF8_CHECK
+        // if input is known to be valid UTF-8.  If ascii is set, input must
+        // be pure ASCII, and the pattern's non-UTF variant is used if it has
+        // one.  If scratch is given, the result is built there and swapped
+        // into input, leaving the old input's storage in scratch for reuse.
+        bool exec(std::string* input, unsigned int length_limit,
+            int exec_options = 0, bool ascii = false,
+            std::string* scratch = NULL) const;
 
     private:
-        pcrecpp::RE *m_RE;
+        int compile_flags(const std::string& source) const;
+        void compile(const std::string& source);
+        void compile_words(const std::vector<std::string>& words, WordList::Boundary boundary);
+        bool exec_literal(std::string* input, unsigned int length_limit,
+            std::string* out) const;
+        bool exec_words(std::string* input, unsigned int length_limit,
+            std::string* out) const;
+
+        std::shared_ptr<const Pattern> m_Pattern;
+        std::shared_ptr<const WordList> m_WordList;
         std::string m_Replacement;
+        Replacement m_Rewrite;
         std::string m_Name;
         bool m_Global;
         bool m_Active;
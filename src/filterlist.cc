@@ -1,9 +1,22 @@
+#include <atomic>
 #include <vector>
 
 #include "./filterlist.h"
 #include "./filter.h"
+#include "./literalrun.h"
+#include "./utf8.h"
 
-FilterList::FilterList()
+static std::atomic<uint64_t> s_Messages(0);
+static std::atomic<uint64_t> s_AsciiMessages(0);
+
+FilterList::FilterList() : m_Gate(true), m_GateDirty(true)
+{
+}
+
+// The gate and runs are not copied, since the copy is usually about to be
+// changed and rebuilt anyway
+FilterList::FilterList(const FilterList& copy)
+    : m_Filters(copy.m_Filters), m_Index(copy.m_Index), m_Gate(true), m_GateDirty(true)
 {
 }
 
@@ -13,56 +26,350 @@ FilterList::~FilterList()
 
 void FilterList::add_filter(const Filter& filter)
 {
-    this->m_Filters.push_back(filter);
+    this->m_Index.emplace(filter.name(), this->m_Filters.size());
+    this->m_Filters.push_back(std::make_shared<const Filter>(filter));
+    this->m_GateDirty = true;
+}
+
+const Filter* FilterList::find_filter(const std::string& name) const
+{
+    std::unordered_map<std::string, size_t>::const_iterator it = this->m_Index.find(name);
+    if (it == this->m_Index.end())
+    {
+        return NULL;
+    }
+
+    return this->m_Filters[it->second].get();
+}
+
+bool FilterList::replace_filter(const Filter& filter)
+{
+    std::unordered_map<std::string, size_t>::const_iterator it =
+        this->m_Index.find(filter.name());
+    if (it == this->m_Index.end())
+    {
+        return false;
+    }
+
+    this->m_Filters[it->second] = std::make_shared<const Filter>(filter);
+    this->m_GateDirty = true;
+    return true;
 }
 
-Filter* FilterList::find_filter(const std::string& name)
+bool FilterList::remove_filter(const std::string& name)
 {
-    std::vector<Filter>::iterator it;
-    for (it = this->m_Filters.begin(); it < this->m_Filters.end(); it++)
+    std::unordered_map<std::string, size_t>::const_iterator it = this->m_Index.find(name);
+    if (it == this->m_Index.end())
     {
-        if (it->name() == name)
+        return false;
+    }
+
+    this->m_Filters.erase(this->m_Filters.begin() + it->second);
+    this->rebuild_index();
+    this->m_GateDirty = true;
+    return true;
+}
+
+void FilterList::move_filter(unsigned int from, unsigned int to)
+{
+    std::swap(this->m_Filters[from], this->m_Filters[to]);
+    this->rebuild_index();
+    this->m_GateDirty = true;
+}
+
+// Marks the members of a longest strictly increasing subsequence of values
+static std::vector<char> LongestIncreasing(const std::vector<size_t>& values)
+{
+    // tails[k] is the index of the smallest value ending an increasing
+    // subsequence of length k + 1
+    std::vector<size_t> tails;
+    std::vector<size_t> previous(values.size());
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        size_t lo = 0, hi = tails.size();
+        while (lo < hi)
+        {
+            size_t mid = (lo + hi) / 2;
+            if (values[tails[mid]] < values[i]) lo = mid + 1;
+            else hi = mid;
+        }
+
+        previous[i] = lo > 0 ? tails[lo - 1] : i;
+        if (lo == tails.size()) tails.push_back(i);
+        else tails[lo] = i;
+    }
+
+    std::vector<char> member(values.size(), 0);
+    if (!tails.empty())
+    {
+        size_t i = tails.back();
+        for (;;)
         {
-            return &(*it);
+            member[i] = 1;
+            if (previous[i] == i) break;
+            i = previous[i];
         }
     }
 
-    return NULL;
+    return member;
 }
 
-bool FilterList::remove_filter(const std::string& name)
+void FilterList::set_filters(const std::vector<Filter>& filters, Changes* changes)
 {
-    std::vector<Filter>::iterator it;
-    for (it = this->m_Filters.begin(); it < this->m_Filters.end(); it++)
+    std::vector<std::shared_ptr<const Filter> > next;
+    std::unordered_map<std::string, size_t> next_index;
+    // Old positions of the filters in both lists, in their new order
+    std::vector<size_t> kept;
+    std::vector<std::string> kept_names;
+
+    for (size_t i = 0; i < filters.size(); i++)
+    {
+        const Filter& filter = filters[i];
+        next_index.emplace(filter.name(), i);
+
+        std::unordered_map<std::string, size_t>::const_iterator it =
+            this->m_Index.find(filter.name());
+        if (it == this->m_Index.end())
+        {
+            changes->added.push_back(filter.name());
+            next.push_back(std::make_shared<const Filter>(filter));
+            continue;
+        }
+
+        const std::shared_ptr<const Filter>& old = this->m_Filters[it->second];
+        if (*old == filter)
+        {
+            next.push_back(old);
+        }
+        else
+        {
+            changes->changed.push_back(filter.name());
+            next.push_back(std::make_shared<const Filter>(filter));
+        }
+
+        kept.push_back(it->second);
+        kept_names.push_back(filter.name());
+    }
+
+    // Including any filter that only shared its name with an earlier one
+    for (size_t i = 0; i < this->m_Filters.size(); i++)
     {
-        if (it->name() == name)
+        const std::string& name = this->m_Filters[i]->name();
+        if (next_index.find(name) == next_index.end() || this->m_Index[name] != i)
         {
-            this->m_Filters.erase(it);
-            return true;
+            changes->removed.push_back(name);
         }
     }
 
-    return false;
+    std::vector<char> in_order = LongestIncreasing(kept);
+    for (size_t i = 0; i < kept.size(); i++)
+    {
+        if (!in_order[i])
+        {
+            changes->moved.push_back(kept_names[i]);
+        }
+    }
+
+    this->m_Filters.swap(next);
+    this->m_Index.swap(next_index);
+    this->m_GateDirty = true;
 }
 
-void FilterList::move_filter(unsigned int from, unsigned int to)
+// Removing or moving a filter is linear anyway, so the index is simply
+// rebuilt.  Names can repeat if the list was built from an array, in which
+// case the first filter wins, as it always has.
+void FilterList::rebuild_index()
 {
-    std::swap(this->m_Filters[from], this->m_Filters[to]);
+    this->m_Index.clear();
+    for (size_t i = 0; i < this->m_Filters.size(); i++)
+    {
+        this->m_Index.emplace(this->m_Filters[i]->name(), i);
+    }
+}
+
+bool FilterList::exec(std::string* input, bool filter_links, unsigned int length_limit)
+{
+    this->prepare();
+
+    const FilterList& prepared = *this;
+    return prepared.exec(input, filter_links, length_limit);
+}
+
+bool FilterList::exec(std::string* input, bool filter_links, unsigned int length_limit) const
+{
+    s_Messages.fetch_add(1, std::memory_order_relaxed);
+
+    // PCRE rejects invalid UTF-8 subjects, so no filter could match.
+    // Otherwise validating once here lets every pcre_exec call skip it.
+    bool ascii = Utf8::IsAscii(input->data(), input->size());
+    if (!ascii && !Utf8::IsValid(input->data(), input->size()))
+    {
+        return false;
+    }
+
+    if (ascii)
+    {
+        s_AsciiMessages.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Each filter builds its result in scratch and swaps it with input, so
+    // the message moves back and forth between the two strings.  Both are
+    // kept per thread and only ever grow, so once they are big enough for
+    // the messages going through, running the filters allocates nothing.
+    static thread_local std::string scratch;
+    static thread_local std::vector<char> candidates;
+
+    // The gate and runs describe the list as it was when last prepared
+    bool prepared = !this->m_GateDirty;
+    if (prepared)
+    {
+        this->scan_gate(*input, candidates);
+    }
+
+    bool any_changed = false;
+    for (size_t i = 0; i < this->m_Filters.size(); i++)
+    {
+        bool changed;
+        int run = prepared ? this->m_RunAt[i] : -1;
+        if (run >= 0 && this->exec_run(this->m_Runs[run], i, input, &scratch,
+            filter_links, length_limit, ascii, candidates, &changed))
+        {
+            i += this->m_Runs[run].size() - 1;
+        }
+        else
+        {
+            const Filter& filter = *this->m_Filters[i];
+            if (!filter.active() || (filter_links && !filter.filter_links()))
+                continue;
+
+            if (prepared && this->m_Gated[i] && !candidates[i])
+                continue;
+
+            changed = filter.exec(input, length_limit, PCRE_NO_UTF8_CHECK, ascii,
+                &scratch);
+        }
+
+        if (changed)
+        {
+            any_changed = true;
+
+            // The replacement may have added non-ASCII text, and a \C in the
+            // pattern can split a character, so check the result again
+            ascii = Utf8::IsAscii(input->data(), input->size());
+            if (!ascii && !Utf8::IsValid(input->data(), input->size()))
+            {
+                return true;
+            }
+
+            // Later filters see the modified message
+            if (prepared)
+            {
+                this->scan_gate(*input, candidates);
+            }
+        }
+    }
+
+    return any_changed;
+}
+
+void FilterList::prepare()
+{
+    if (this->m_GateDirty)
+    {
+        this->rebuild_gate();
+    }
+}
+
+// Applies the run of filters starting at first in one pass.  Returns false
+// if they have to be run one at a time instead.
+bool FilterList::exec_run(const LiteralRun& run, size_t first, std::string* input,
+    std::string* scratch, bool filter_links, unsigned int length_limit, bool ascii,
+    const std::vector<char>& candidates, bool* changed) const
+{
+    if (run.needs_ascii() && !ascii)
+    {
+        return false;
+    }
+
+    bool any_candidate = false;
+    for (size_t i = first; i < first + run.size(); i++)
+    {
+        const Filter& filter = *this->m_Filters[i];
+        if (!filter.active() || (filter_links && !filter.filter_links()))
+        {
+            return false;
+        }
+
+        if (!this->m_Gated[i] || candidates[i])
+        {
+            any_candidate = true;
+        }
+    }
+
+    if (!any_candidate)
+    {
+        *changed = false;
+        return true;
+    }
+
+    return run.exec(input, length_limit, changed, scratch);
 }
 
-void FilterList::exec(std::string* input, bool filter_links, unsigned int length_limit)
+void FilterList::rebuild_gate()
 {
-    std::vector<Filter>::iterator it;
-    for (it = this->m_Filters.begin(); it < this->m_Filters.end(); it++)
+    this->m_Gate.clear();
+    this->m_Gated.assign(this->m_Filters.size(), 0);
+
+    for (size_t i = 0; i < this->m_Filters.size(); i++)
+    {
+        const Pattern *pattern = this->m_Filters[i]->pattern();
+        if (pattern != NULL && !pattern->required_literal().empty())
+        {
+            this->m_Gate.add(pattern->required_literal(), i);
+            this->m_Gated[i] = 1;
+        }
+    }
+
+    this->m_Gate.build();
+
+    // Group adjacent filters into runs that can share a pass
+    this->m_Runs.clear();
+    this->m_RunAt.assign(this->m_Filters.size(), -1);
+    LiteralRun run;
+    for (size_t i = 0; i <= this->m_Filters.size(); i++)
     {
-        if (!it->active() || (filter_links && !it->filter_links()))
+        if (i < this->m_Filters.size() && run.can_append(*this->m_Filters[i]))
+        {
+            run.append(*this->m_Filters[i]);
             continue;
+        }
 
-        it->exec(input, length_limit);
+        if (run.size() > 1)
+        {
+            this->m_RunAt[i - run.size()] = this->m_Runs.size();
+            this->m_Runs.push_back(run);
+        }
+
+        run = LiteralRun();
+        if (i < this->m_Filters.size() && run.can_append(*this->m_Filters[i]))
+        {
+            run.append(*this->m_Filters[i]);
+        }
     }
+
+    this->m_GateDirty = false;
 }
 
-const std::vector<Filter>& FilterList::filters() const
+void FilterList::scan_gate(const std::string& input, std::vector<char>& candidates) const
+{
+    candidates.assign(this->m_Filters.size(), 0);
+    this->m_Gate.scan(input.data(), input.size(), [&candidates](size_t, unsigned int id) {
+        candidates[id] = 1;
+        return true;
+    });
+}
+
+const std::vector<std::shared_ptr<const Filter> >& FilterList::filters() const
 {
     return this->m_Filters;
 }
@@ -71,3 +378,23 @@ std::vector<Filter>::size_type FilterList::size() const
 {
     return this->m_Filters.size();
 }
+
+size_t FilterList::memory_usage() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i < this->m_Filters.size(); i++)
+    {
+        total += this->m_Filters[i]->memory_usage();
+    }
+
+    return total;
+}
+
+FilterList::ExecStats FilterList::exec_stats()
+{
+    ExecStats stats;
+    stats.messages = s_Messages.load(std::memory_order_relaxed);
+    stats.ascii_messages = s_AsciiMessages.load(std::memory_order_relaxed);
+
+    return stats;
+}
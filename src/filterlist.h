@@ -1,23 +1,93 @@
 #pragma once
 
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "./ahocorasick.h"
 #include "./filter.h"
+#include "./literalrun.h"
 
 class FilterList
 {
     public:
+        // Counters shared by every FilterList in the process
+        struct ExecStats
+        {
+            uint64_t messages;
+            // Messages that were pure ASCII and so could use the non-UTF
+            // variants of the filters
+            uint64_t ascii_messages;
+        };
+
+        // What set_filters changed, by filter name
+        struct Changes
+        {
+            std::vector<std::string> added;
+            std::vector<std::string> removed;
+            std::vector<std::string> changed;
+            std::vector<std::string> moved;
+        };
+
         FilterList();
+        // Filters are never changed once added, so a copy shares them, and
+        // their compiled patterns, with the original
+        FilterList(const FilterList& copy);
         ~FilterList();
 
         void add_filter(const Filter& filter);
-        Filter* find_filter(const std::string& name);
+        const Filter* find_filter(const std::string& name) const;
+        // Replaces the filter with the same name as filter.  Returns false
+        // if there is none.
+        bool replace_filter(const Filter& filter);
         bool remove_filter(const std::string& name);
         void move_filter(unsigned int from, unsigned int to);
+        // Replaces every filter with filters, whose names must all differ.
+        // Where the old filter with the same name is equal, it is kept, so
+        // its compiled pattern is reused.  Filters in both lists whose order
+        // relative to the others changed are reported as moved, picking as
+        // few as possible.
+        void set_filters(const std::vector<Filter>& filters, Changes* changes);
 
-        void exec(std::string* input, bool filter_links, unsigned int length_limit);
-        const std::vector<Filter>& filters() const;
+        // Returns true if any filter changed input.  input may end up with
+        // different storage, taken from a buffer that is reused between
+        // calls on the same thread.
+        bool exec(std::string* input, bool filter_links, unsigned int length_limit);
+        // The same, without preparing the list first.  Any number of
+        // threads may call it at once on a list that nothing changes.  If
+        // the list changed since it was last prepared, every filter is run
+        // on its own, which gives the same result more slowly.
+        bool exec(std::string* input, bool filter_links, unsigned int length_limit) const;
+        // Does the work that exec otherwise does on its first call after a
+        // change
+        void prepare();
+        const std::vector<std::shared_ptr<const Filter> >& filters() const;
         std::vector<Filter>::size_type size() const;
+        size_t memory_usage() const;
+
+        static ExecStats exec_stats();
     private:
-        std::vector<Filter> m_Filters;
+        void rebuild_index();
+        void rebuild_gate();
+        void scan_gate(const std::string& input, std::vector<char>& candidates) const;
+        bool exec_run(const LiteralRun& run, size_t first, std::string* input,
+            std::string* scratch, bool filter_links, unsigned int length_limit, bool ascii,
+            const std::vector<char>& candidates, bool* changed) const;
+
+        std::vector<std::shared_ptr<const Filter> > m_Filters;
+        // Index in m_Filters of the first filter with each name
+        std::unordered_map<std::string, size_t> m_Index;
+
+        // Required literals of every filter that has one.  A filter whose
+        // literal does not occur in the message is not run.  Rebuilt lazily
+        // whenever the list changes.
+        AhoCorasick m_Gate;
+        std::vector<char> m_Gated;
+        // Runs of adjacent filters that are applied in a single pass, and
+        // the index in m_Runs of the run starting at each filter, or -1
+        std::vector<LiteralRun> m_Runs;
+        std::vector<int> m_RunAt;
+        bool m_GateDirty;
 };
@@ -1,12 +1,20 @@
+#include <atomic>
+#include <mutex>
 #include <node.h>
 #include <nan.h>
 #include <pcrecpp.h>
 #include <sstream>
+#include <unordered_set>
+#include <uv.h>
 
+#include "./allocations.h"
+#include "./executor.h"
 #include "./jsfilterlist.h"
 #include "./filterlist.h"
 #include "./filter.h"
+#include "./patterncache.h"
 #include "./util.h"
+#include "./wordlist.h"
 
 using v8::Array;
 using v8::Boolean;
@@ -18,9 +26,8 @@ using v8::Persistent;
 using v8::String;
 using v8::Value;
 
-static Nan::Persistent<FunctionTemplate> constructor;
-
-JSFilterList::JSFilterList(const FilterList& filter_list) : m_FilterList(filter_list)
+JSFilterList::JSFilterList(const FilterList& filter_list)
+    : m_FilterList(std::make_shared<FilterList>(filter_list))
 {
 }
 
@@ -28,38 +35,29 @@ JSFilterList::~JSFilterList()
 {
 }
 
-NAN_METHOD(JSFilterList::New)
+// Converts an array of filter objects, throwing and returning false if it
+// is not one
+static bool ReadFilters(const Local<Value>& value, const char *not_array,
+    std::vector<Filter>& dest)
 {
-    Nan::HandleScope scope;
-
-    JSFilterList *wrap;
-    FilterList filter_list;
-    if (info.Length() == 0)
-    {
-        wrap = new JSFilterList(filter_list);
-        wrap->Wrap(info.This());
-        info.GetReturnValue().Set(info.This());
-        return;
-    }
-
-    if (!info[0]->IsArray())
+    if (!value->IsArray())
     {
-        Nan::ThrowTypeError("Argument to FilterList constructor must be an array");
-        return;
+        Nan::ThrowTypeError(not_array);
+        return false;
     }
 
     Local<Object> filters;
-    if (!Nan::To<Object>(info[0]).ToLocal(&filters))
+    if (!Nan::To<Object>(value).ToLocal(&filters))
     {
         Nan::ThrowTypeError("Could not convert argument to object");
-        return;
+        return false;
     }
 
     Local<Array> indexes;
     if (!Nan::GetPropertyNames(filters).ToLocal(&indexes))
     {
         Nan::ThrowTypeError("Could not get array indexes");
-        return;
+        return false;
     }
 
     for (uint32_t i = 0; i < indexes->Length(); i++)
@@ -70,7 +68,7 @@ NAN_METHOD(JSFilterList::New)
             std::ostringstream oss;
             oss << "Filter at index " << i << " is not an object";
             Nan::ThrowTypeError(oss.str().c_str());
-            return;
+            return false;
         }
         else
         {
@@ -80,44 +78,574 @@ NAN_METHOD(JSFilterList::New)
                 std::ostringstream oss;
                 oss << "Filter at index " << i << " is invalid";
                 Nan::ThrowTypeError(oss.str().c_str());
-                return;
+                return false;
             }
 
-            filter_list.add_filter(filter);
+            dest.push_back(filter);
         }
     }
 
+    return true;
+}
+
+NAN_METHOD(JSFilterList::New)
+{
+    Nan::HandleScope scope;
+
+    JSFilterList *wrap;
+    FilterList filter_list;
+    if (info.Length() == 0)
+    {
+        wrap = new JSFilterList(filter_list);
+        wrap->Wrap(info.This());
+        info.GetReturnValue().Set(info.This());
+        return;
+    }
+
+    std::vector<Filter> filters;
+    if (!ReadFilters(info[0], "Argument to FilterList constructor must be an array", filters))
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < filters.size(); i++)
+    {
+        filter_list.add_filter(filters[i]);
+    }
+
     wrap = new JSFilterList(filter_list);
     wrap->Wrap(info.This());
 
     info.GetReturnValue().Set(info.This());
 }
 
+static const unsigned int DEFAULT_LENGTH_LIMIT = 1000;
+
+static uint32_t GetLengthLimit(const Local<Value>& value)
+{
+    uint32_t length_limit = DEFAULT_LENGTH_LIMIT;
+    if (value->IsNumber())
+    {
+        length_limit = Nan::To<uint32_t>(value).FromMaybe(length_limit);
+    }
+
+    return length_limit;
+}
+
+// Runs the list over one message and sets result to the filtered string
+static bool FilterValue(const FilterList& filter_list, const Local<Value>& message,
+    bool filter_links, uint32_t length_limit, Local<Value>& result)
+{
+    // Reused between calls, see FilterList::exec
+    static thread_local std::string input;
+    bool exact = Util::ReadUtf8(message, input);
+
+    // Nothing matched, which is the usual case, so the original string
+    // can be handed back instead of building a copy
+    if (!filter_list.exec(&input, filter_links, length_limit) && exact)
+    {
+        result = message;
+        return true;
+    }
+
+    Local<String> str;
+    if (!Util::ToJSString(input, str))
+    {
+        return false;
+    }
+
+    result = str;
+    return true;
+}
+
 NAN_METHOD(JSFilterList::FilterString)
 {
     Nan::HandleScope scope;
-    static const unsigned int DEFAULT_LENGTH_LIMIT = 1000;
 
-    std::string input = *Nan::Utf8String(info[0]);
     bool filter_links = Nan::To<bool>(info[1]).FromMaybe(false);
-    uint32_t length_limit = DEFAULT_LENGTH_LIMIT;
-    if (info[2]->IsNumber())
+    uint32_t length_limit = GetLengthLimit(info[2]);
+
+    // Held for the whole call, since reading the message can run JS (its
+    // toString) that changes the list
+    JSFilterList *wrap = ObjectWrap::Unwrap<JSFilterList>(info.This());
+    std::shared_ptr<const FilterList> filter_list = wrap->shared();
+
+    Local<Value> rv;
+    if (!FilterValue(*filter_list, info[0], filter_links, length_limit, rv))
+    {
+        Nan::ThrowError("Unable to create return value");
+        return;
+    }
+
+    info.GetReturnValue().Set(rv);
+}
+
+NAN_METHOD(JSFilterList::FilterMany)
+{
+    Nan::HandleScope scope;
+
+    if (!info[0]->IsArray())
     {
-        length_limit = Nan::To<uint32_t>(info[2]).FromMaybe(length_limit);
+        Nan::ThrowTypeError("Argument to filterMany must be an array");
+        return;
     }
 
+    Local<Array> messages = info[0].As<Array>();
+    bool filter_links = Nan::To<bool>(info[1]).FromMaybe(false);
+    uint32_t length_limit = GetLengthLimit(info[2]);
+
+    // Results go into the caller's array if one is given, resized to fit
+    Local<Array> results;
+    if (info[3]->IsArray())
+    {
+        results = info[3].As<Array>();
+        Nan::Set(results, Nan::New<String>("length").ToLocalChecked(),
+            Nan::New<Number>(messages->Length()));
+    }
+    else
+    {
+        results = Nan::New<Array>(messages->Length());
+    }
+
+    // Every message is filtered with the list as it was when called, even
+    // if a getter or toString changes it in between
     JSFilterList *wrap = ObjectWrap::Unwrap<JSFilterList>(info.This());
+    std::shared_ptr<const FilterList> filter_list = wrap->shared();
 
-    wrap->m_FilterList.exec(&input, filter_links, length_limit);
+    for (uint32_t i = 0; i < messages->Length(); i++)
+    {
+        Local<Value> message;
+        Local<Value> result;
+        if (!Nan::Get(messages, i).ToLocal(&message) ||
+            !FilterValue(*filter_list, message, filter_links, length_limit, result))
+        {
+            std::ostringstream oss;
+            oss << "Unable to filter message at index " << i;
+            Nan::ThrowError(oss.str().c_str());
+            return;
+        }
 
-    Local<String> rv;
-    if (!Nan::New<String>(input).ToLocal(&rv))
+        Nan::Set(results, i, result);
+    }
+
+    info.GetReturnValue().Set(results);
+}
+
+// Reads messages into inputs for filtering off the main thread.  Returns a
+// copy of the array, so that unchanged messages can be returned as they
+// were even if the caller's array changes in the meantime.
+static Local<Array> ReadMessages(const Local<Array>& messages,
+    std::vector<std::string>& inputs, std::vector<char>& exact)
+{
+    Local<Array> originals = Nan::New<Array>(messages->Length());
+    for (uint32_t i = 0; i < messages->Length(); i++)
+    {
+        Local<Value> message;
+        if (!Nan::Get(messages, i).ToLocal(&message))
+        {
+            message = Nan::Undefined();
+        }
+
+        std::string input;
+        exact.push_back(Util::ReadUtf8(message, input));
+        inputs.push_back(input);
+        Nan::Set(originals, i, message);
+    }
+
+    return originals;
+}
+
+// Makes the arguments for a node-style callback from the filtered messages:
+// a string if many is false, otherwise an array
+static void MakeCallbackArgs(const Local<Array>& originals,
+    const std::vector<std::string>& outputs, const std::vector<char>& exact,
+    const std::vector<char>& changed, bool many, Local<Value> argv[2])
+{
+    Local<Array> results = Nan::New<Array>(outputs.size());
+    for (uint32_t i = 0; i < outputs.size(); i++)
+    {
+        Local<Value> result;
+        Local<String> str;
+        if (!changed[i] && exact[i])
+        {
+            result = Nan::Get(originals, i).ToLocalChecked();
+        }
+        else if (Util::ToJSString(outputs[i], str))
+        {
+            result = str;
+        }
+        else
+        {
+            argv[0] = Nan::Error("Unable to create return value");
+            argv[1] = Nan::Undefined();
+            return;
+        }
+
+        Nan::Set(results, i, result);
+    }
+
+    argv[0] = Nan::Null();
+    argv[1] = many ? Local<Value>(results) : Nan::Get(results, 0).ToLocalChecked();
+}
+
+// Filters messages on the libuv threadpool against the list as it was when
+// the call was made, and passes the results to a
+// node-style callback: a string for filterAsync or an array for
+// filterManyAsync
+class FilterWorker : public Nan::AsyncWorker
+{
+    public:
+        FilterWorker(Nan::Callback *callback, std::shared_ptr<const FilterList> filter_list,
+            const Local<Array>& messages, bool filter_links, uint32_t length_limit,
+            bool many)
+            : Nan::AsyncWorker(callback, "cytubefilters:FilterWorker"),
+            m_FilterList(filter_list),
+            m_FilterLinks(filter_links),
+            m_LengthLimit(length_limit),
+            m_Many(many)
+        {
+            this->SaveToPersistent("messages",
+                ReadMessages(messages, this->m_Messages, this->m_Exact));
+        }
+
+        void Execute()
+        {
+            for (size_t i = 0; i < this->m_Messages.size(); i++)
+            {
+                this->m_Changed.push_back(this->m_FilterList->exec(&this->m_Messages[i],
+                    this->m_FilterLinks, this->m_LengthLimit));
+            }
+        }
+
+    protected:
+        void HandleOKCallback()
+        {
+            Nan::HandleScope scope;
+
+            Local<Value> argv[2];
+            MakeCallbackArgs(this->GetFromPersistent("messages").As<Array>(),
+                this->m_Messages, this->m_Exact, this->m_Changed, this->m_Many, argv);
+            this->callback->Call(argv[0]->IsNull() ? 2 : 1, argv, this->async_resource);
+        }
+
+    private:
+        std::shared_ptr<const FilterList> m_FilterList;
+        std::vector<std::string> m_Messages;
+        std::vector<char> m_Exact;
+        std::vector<char> m_Changed;
+        bool m_FilterLinks;
+        uint32_t m_LengthLimit;
+        bool m_Many;
+};
+
+class FilterBatch;
+
+// Hands batches finished on the executor back to the event loop of the
+// environment that submitted them.  Pool threads queue them and signal a
+// single uv_async_t, and the loop then delivers everything that finished
+// since it last ran.  There is one per environment, made on first use.
+class CompletionPort
+{
+    public:
+        static std::shared_ptr<CompletionPort> Current();
+
+        // On the loop thread, before a batch is submitted; keeps the loop
+        // alive until the batch is delivered
+        void started();
+        // On any thread
+        void post(FilterBatch *batch);
+
+    private:
+        static void OnAsync(uv_async_t *handle);
+        static void OnClose(uv_handle_t *handle);
+        static void Cleanup(void *arg);
+
+        static thread_local std::shared_ptr<CompletionPort> s_Current;
+
+        uv_async_t *m_Async;
+        std::mutex m_Mutex;
+        std::vector<FilterBatch*> m_Done;
+        bool m_Closed;
+        // Only used on the loop thread
+        size_t m_Pending;
+};
+
+// Filters messages on the executor, one task per message so that a batch
+// is spread over every core, and passes an array of results to a
+// node-style callback once they have all finished
+class FilterBatch
+{
+    public:
+        FilterBatch(Nan::Callback *callback, std::shared_ptr<const FilterList> filter_list,
+            const Local<Array>& messages, bool filter_links, uint32_t length_limit)
+            : m_Callback(callback),
+            m_Resource("cytubefilters:FilterBatch"),
+            m_FilterList(filter_list),
+            m_FilterLinks(filter_links),
+            m_LengthLimit(length_limit),
+            m_Port(CompletionPort::Current())
+        {
+            this->m_Originals.Reset(ReadMessages(messages, this->m_Messages, this->m_Exact));
+            // One byte each rather than vector<bool>, since tasks for
+            // different messages write to it at the same time
+            this->m_Changed.assign(this->m_Messages.size(), false);
+        }
+
+        ~FilterBatch()
+        {
+            this->m_Originals.Reset();
+        }
+
+        void submit()
+        {
+            this->m_Port->started();
+            this->m_Remaining.store(this->m_Messages.size());
+            if (this->m_Messages.empty())
+            {
+                this->m_Port->post(this);
+                return;
+            }
+
+            this->m_Tasks.resize(this->m_Messages.size());
+            for (size_t i = 0; i < this->m_Tasks.size(); i++)
+            {
+                this->m_Tasks[i].batch = this;
+                this->m_Tasks[i].index = i;
+                Executor::Get().submit(&this->m_Tasks[i]);
+            }
+        }
+
+        void deliver()
+        {
+            Nan::HandleScope scope;
+
+            Local<Value> argv[2];
+            MakeCallbackArgs(Nan::New(this->m_Originals), this->m_Messages,
+                this->m_Exact, this->m_Changed, true, argv);
+            this->m_Callback->Call(argv[0]->IsNull() ? 2 : 1, argv, &this->m_Resource);
+        }
+
+    private:
+        class Task : public Executor::Task
+        {
+            public:
+                void run()
+                {
+                    FilterBatch *batch = this->batch;
+                    batch->m_Changed[this->index] = batch->m_FilterList->exec(
+                        &batch->m_Messages[this->index], batch->m_FilterLinks,
+                        batch->m_LengthLimit);
+                }
+
+                // Once posted, the batch and its tasks may be deleted at
+                // any time
+                void done()
+                {
+                    FilterBatch *batch = this->batch;
+                    if (batch->m_Remaining.fetch_sub(1) == 1)
+                    {
+                        batch->m_Port->post(batch);
+                    }
+                }
+
+                FilterBatch *batch;
+                size_t index;
+        };
+
+        std::unique_ptr<Nan::Callback> m_Callback;
+        Nan::AsyncResource m_Resource;
+        Nan::Persistent<Array> m_Originals;
+        std::shared_ptr<const FilterList> m_FilterList;
+        std::vector<std::string> m_Messages;
+        std::vector<char> m_Exact;
+        std::vector<char> m_Changed;
+        std::vector<Task> m_Tasks;
+        std::atomic<size_t> m_Remaining;
+        bool m_FilterLinks;
+        uint32_t m_LengthLimit;
+        std::shared_ptr<CompletionPort> m_Port;
+};
+
+thread_local std::shared_ptr<CompletionPort> CompletionPort::s_Current;
+
+std::shared_ptr<CompletionPort> CompletionPort::Current()
+{
+    if (!s_Current)
+    {
+        std::shared_ptr<CompletionPort> port = std::make_shared<CompletionPort>();
+        port->m_Async = new uv_async_t();
+        port->m_Async->data = port.get();
+        port->m_Closed = false;
+        port->m_Pending = 0;
+        uv_async_init(Nan::GetCurrentEventLoop(), port->m_Async, CompletionPort::OnAsync);
+        uv_unref(reinterpret_cast<uv_handle_t*>(port->m_Async));
+
+        node::AddEnvironmentCleanupHook(v8::Isolate::GetCurrent(),
+            CompletionPort::Cleanup, port.get());
+        s_Current = port;
+    }
+
+    return s_Current;
+}
+
+void CompletionPort::started()
+{
+    if (this->m_Pending++ == 0)
+    {
+        uv_ref(reinterpret_cast<uv_handle_t*>(this->m_Async));
+    }
+}
+
+void CompletionPort::post(FilterBatch *batch)
+{
+    std::lock_guard<std::mutex> lock(this->m_Mutex);
+
+    // The environment has gone away, and with it the isolate that the
+    // batch's handles belong to, so it is left as it is
+    if (this->m_Closed)
     {
-        Nan::ThrowError("Unable to create return value");
         return;
     }
 
-    info.GetReturnValue().Set(rv);
+    this->m_Done.push_back(batch);
+    uv_async_send(this->m_Async);
+}
+
+void CompletionPort::OnAsync(uv_async_t *handle)
+{
+    CompletionPort *port = static_cast<CompletionPort*>(handle->data);
+
+    std::vector<FilterBatch*> done;
+    {
+        std::lock_guard<std::mutex> lock(port->m_Mutex);
+        done.swap(port->m_Done);
+    }
+
+    for (size_t i = 0; i < done.size(); i++)
+    {
+        done[i]->deliver();
+        delete done[i];
+    }
+
+    port->m_Pending -= done.size();
+    if (port->m_Pending == 0)
+    {
+        uv_unref(reinterpret_cast<uv_handle_t*>(port->m_Async));
+    }
+}
+
+void CompletionPort::OnClose(uv_handle_t *handle)
+{
+    delete reinterpret_cast<uv_async_t*>(handle);
+}
+
+// Batches still running hold on to the port, so only the handle is closed
+// here; they find the port closed when they finish
+void CompletionPort::Cleanup(void *arg)
+{
+    CompletionPort *port = static_cast<CompletionPort*>(arg);
+    {
+        std::lock_guard<std::mutex> lock(port->m_Mutex);
+        port->m_Closed = true;
+    }
+
+    uv_close(reinterpret_cast<uv_handle_t*>(port->m_Async), CompletionPort::OnClose);
+    s_Current.reset();
+}
+
+std::shared_ptr<const FilterList> JSFilterList::shared()
+{
+    this->m_FilterList->prepare();
+    return this->m_FilterList;
+}
+
+FilterList& JSFilterList::writable()
+{
+    if (this->m_FilterList.use_count() > 1)
+    {
+        this->m_FilterList = std::make_shared<FilterList>(*this->m_FilterList);
+    }
+    else
+    {
+        // Pairs with the release of the last other reference, so that its
+        // reads of the list happen before the change
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+
+    return *this->m_FilterList;
+}
+
+// The callback is required here; index.js returns a Promise without one
+NAN_METHOD(JSFilterList::FilterAsync)
+{
+    Nan::HandleScope scope;
+
+    if (!info[3]->IsFunction())
+    {
+        Nan::ThrowTypeError("Callback must be a function");
+        return;
+    }
+
+    Local<Array> messages = Nan::New<Array>(1);
+    Nan::Set(messages, 0, info[0]);
+    bool filter_links = Nan::To<bool>(info[1]).FromMaybe(false);
+    uint32_t length_limit = GetLengthLimit(info[2]);
+    Nan::Callback *callback = new Nan::Callback(info[3].As<v8::Function>());
+
+    JSFilterList *wrap = ObjectWrap::Unwrap<JSFilterList>(info.This());
+    Nan::AsyncQueueWorker(new FilterWorker(callback, wrap->shared(), messages,
+        filter_links, length_limit, false));
+}
+
+NAN_METHOD(JSFilterList::FilterManyAsync)
+{
+    Nan::HandleScope scope;
+
+    if (!info[0]->IsArray())
+    {
+        Nan::ThrowTypeError("Argument to filterManyAsync must be an array");
+        return;
+    }
+
+    if (!info[3]->IsFunction())
+    {
+        Nan::ThrowTypeError("Callback must be a function");
+        return;
+    }
+
+    bool filter_links = Nan::To<bool>(info[1]).FromMaybe(false);
+    uint32_t length_limit = GetLengthLimit(info[2]);
+    Nan::Callback *callback = new Nan::Callback(info[3].As<v8::Function>());
+
+    JSFilterList *wrap = ObjectWrap::Unwrap<JSFilterList>(info.This());
+    Nan::AsyncQueueWorker(new FilterWorker(callback, wrap->shared(),
+        info[0].As<Array>(), filter_links, length_limit, true));
+}
+
+NAN_METHOD(JSFilterList::FilterManyParallel)
+{
+    Nan::HandleScope scope;
+
+    if (!info[0]->IsArray())
+    {
+        Nan::ThrowTypeError("Argument to filterManyParallel must be an array");
+        return;
+    }
+
+    if (!info[3]->IsFunction())
+    {
+        Nan::ThrowTypeError("Callback must be a function");
+        return;
+    }
+
+    bool filter_links = Nan::To<bool>(info[1]).FromMaybe(false);
+    uint32_t length_limit = GetLengthLimit(info[2]);
+    Nan::Callback *callback = new Nan::Callback(info[3].As<v8::Function>());
+
+    JSFilterList *wrap = ObjectWrap::Unwrap<JSFilterList>(info.This());
+    FilterBatch *batch = new FilterBatch(callback, wrap->shared(), info[0].As<Array>(),
+        filter_links, length_limit);
+    batch->submit();
 }
 
 NAN_METHOD(JSFilterList::Pack)
@@ -125,15 +653,14 @@ NAN_METHOD(JSFilterList::Pack)
     Nan::HandleScope scope;
 
     JSFilterList *wrap = ObjectWrap::Unwrap<JSFilterList>(info.This());
-    std::vector<Filter> filters = wrap->m_FilterList.filters();
+    const std::vector<std::shared_ptr<const Filter> >& filters =
+        wrap->m_FilterList->filters();
     Local<Array> result = Nan::New<Array>();
-    unsigned int i = 0;
 
-    std::vector<Filter>::iterator it;
-    for (it = filters.begin(); it < filters.end(); it++, i++)
+    for (uint32_t i = 0; i < filters.size(); i++)
     {
         Local<Object> filter = Nan::New<Object>();
-        if (!Util::ToJSObject(*it, filter))
+        if (!Util::ToJSObject(*filters[i], filter))
         {
             Nan::ThrowError("Unable to convert filter to JS object");
             return;
@@ -184,14 +711,20 @@ NAN_METHOD(JSFilterList::UpdateFilter)
 
     std::string name = *Nan::Utf8String(nameVal);
     JSFilterList *wrap = ObjectWrap::Unwrap<JSFilterList>(info.This());
-    Filter *filter = wrap->m_FilterList.find_filter(name);
+    const Filter *existing = wrap->m_FilterList->find_filter(name);
 
-    if (filter == NULL)
+    if (existing == NULL)
     {
         Nan::ThrowError("Filter to be updated does not exist");
         return;
     }
 
+    // Changed on a copy, so that nothing changes if a field is invalid
+    Filter filter(*existing);
+
+    bool has_boundary = false;
+    WordList::Boundary boundary = WordList::BOUNDARY_WORD;
+
     Local<Array> fields;
     if (!Nan::GetPropertyNames(obj).ToLocal(&fields))
     {
@@ -230,28 +763,64 @@ NAN_METHOD(JSFilterList::UpdateFilter)
 
         if (sfield == "source")
         {
-            filter->set_source(*Nan::Utf8String(value));
+            filter.set_source(*Nan::Utf8String(value));
         }
         else if (sfield == "replace")
         {
-            filter->set_replacement(*Nan::Utf8String(value));
+            filter.set_replacement(*Nan::Utf8String(value));
         }
         else if (sfield == "flags")
         {
-            filter->set_flags(*Nan::Utf8String(value));
+            filter.set_flags(*Nan::Utf8String(value));
         }
         else if (sfield == "active")
         {
-            filter->set_active(Nan::To<bool>(value).FromMaybe(false));
+            filter.set_active(Nan::To<bool>(value).FromMaybe(false));
         }
         else if (sfield == "filterlinks")
         {
-            filter->set_filter_links(Nan::To<bool>(value).FromMaybe(false));
+            filter.set_filter_links(Nan::To<bool>(value).FromMaybe(false));
+        }
+        else if (sfield == "words")
+        {
+            std::vector<std::string> words;
+            if (!Util::ToStringVector(value, words))
+            {
+                Nan::ThrowTypeError("Field words must be an array of strings");
+                return;
+            }
+
+            filter.set_words(words);
+        }
+        else if (sfield == "boundary")
+        {
+            if (!value->IsString() ||
+                !WordList::ParseBoundary(*Nan::Utf8String(value), &boundary))
+            {
+                Nan::ThrowTypeError("Field boundary must be \"word\" or \"none\"");
+                return;
+            }
+
+            has_boundary = true;
         }
     }
 
+    // Applied last, since words may turn the filter into a word list
+    if (has_boundary)
+    {
+        if (filter.word_list() == NULL)
+        {
+            Nan::ThrowError("Field boundary only applies to word list filters");
+            return;
+        }
+
+        filter.set_boundary(boundary);
+    }
+
+    wrap->writable().replace_filter(filter);
+
     Local<Object> retval = Nan::New<Object>();
-    if (!Util::ToJSObject(*filter, retval))
+    if (!Util::ToJSObject(filter, retval))
     {
         Nan::ThrowError("Unable to pack filter to JS object");
         return;
@@ -300,8 +869,9 @@ NAN_METHOD(JSFilterList::RemoveFilter)
     std::string name = *Nan::Utf8String(nameVal);
     JSFilterList *wrap = ObjectWrap::Unwrap<JSFilterList>(info.This());
 
-    Local<Boolean> removed = Nan::New<Boolean>(wrap->m_FilterList.remove_filter(name));
-    info.GetReturnValue().Set(removed);
+    bool removed = wrap->m_FilterList->find_filter(name) != NULL &&
+        wrap->writable().remove_filter(name);
+    info.GetReturnValue().Set(Nan::New<Boolean>(removed));
 }
 
 NAN_METHOD(JSFilterList::MoveFilter)
@@ -333,13 +903,68 @@ NAN_METHOD(JSFilterList::MoveFilter)
                                    to   = i32to.FromJust();
 
     JSFilterList *wrap = ObjectWrap::Unwrap<JSFilterList>(info.This());
-    if (from >= wrap->m_FilterList.size() || to >= wrap->m_FilterList.size())
+    if (from >= wrap->m_FilterList->size() || to >= wrap->m_FilterList->size())
     {
         Nan::ThrowError("Argument out of range");
         return;
     }
 
-    wrap->m_FilterList.move_filter(from, to);
+    wrap->writable().move_filter(from, to);
+}
+
+static Local<Array> ToJSArray(const std::vector<std::string>& strings)
+{
+    Local<Array> array = Nan::New<Array>(strings.size());
+    for (uint32_t i = 0; i < strings.size(); i++)
+    {
+        Nan::Set(array, i, Nan::New<String>(strings[i]).ToLocalChecked());
+    }
+
+    return array;
+}
+
+NAN_METHOD(JSFilterList::SetFilters)
+{
+    Nan::HandleScope scope;
+
+    // Every filter is read before anything changes, so an invalid one
+    // leaves the list as it was
+    std::vector<Filter> filters;
+    if (!ReadFilters(info[0], "Argument to setFilters must be an array", filters))
+    {
+        return;
+    }
+
+    std::unordered_set<std::string> names;
+    for (size_t i = 0; i < filters.size(); i++)
+    {
+        if (!names.insert(filters[i].name()).second)
+        {
+            Nan::ThrowError(("Filter '" + filters[i].name() + "' appears more than once").c_str());
+            return;
+        }
+    }
+
+    JSFilterList *wrap = ObjectWrap::Unwrap<JSFilterList>(info.This());
+    FilterList::Changes changes;
+    wrap->writable().set_filters(filters, &changes);
+
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result, Nan::New<String>("added").ToLocalChecked(), ToJSArray(changes.added));
+    Nan::Set(result, Nan::New<String>("removed").ToLocalChecked(), ToJSArray(changes.removed));
+    Nan::Set(result, Nan::New<String>("changed").ToLocalChecked(), ToJSArray(changes.changed));
+    Nan::Set(result, Nan::New<String>("moved").ToLocalChecked(), ToJSArray(changes.moved));
+
+    info.GetReturnValue().Set(result);
+}
+
+NAN_METHOD(JSFilterList::MemoryUsage)
+{
+    Nan::HandleScope scope;
+
+    JSFilterList *wrap = ObjectWrap::Unwrap<JSFilterList>(info.This());
+
+    info.GetReturnValue().Set(Nan::New<Number>(wrap->m_FilterList->memory_usage()));
 }
 
 NAN_METHOD(JSFilterList::AddFilter)
@@ -374,9 +999,7 @@ NAN_METHOD(JSFilterList::AddFilter)
         return;
     }
 
-    Filter *filter = wrap->m_FilterList.find_filter(name);
-
-    if (filter != NULL)
+    if (wrap->m_FilterList->find_filter(name) != NULL)
     {
         Nan::ThrowError(("Filter '" + name + "' already exists.  Please choose a different name").c_str());
         return;
@@ -389,14 +1012,14 @@ NAN_METHOD(JSFilterList::AddFilter)
         return;
     }
 
-    wrap->m_FilterList.add_filter(newFilter);
+    wrap->writable().add_filter(newFilter);
 }
 
 NAN_PROPERTY_GETTER(JSFilterList::GetLength)
 {
     JSFilterList *wrap = ObjectWrap::Unwrap<JSFilterList>(info.This());
 
-    info.GetReturnValue().Set(Nan::New<Number>(wrap->m_FilterList.size()));
+    info.GetReturnValue().Set(Nan::New<Number>(wrap->m_FilterList->size()));
 }
 
 NAN_METHOD(JSFilterList::QuoteMeta)
@@ -422,7 +1045,120 @@ NAN_METHOD(JSFilterList::CheckValidRegex)
     info.GetReturnValue().Set(Nan::True());
 }
 
-void JSFilterList::Init()
+NAN_METHOD(JSFilterList::CacheStats)
+{
+    Nan::HandleScope scope;
+
+    PatternCache::Stats stats = PatternCache::GetStats();
+    Local<Object> result = Nan::New<Object>();
+
+    Nan::Set(result, Nan::New<String>("hits").ToLocalChecked(),
+        Nan::New<Number>(static_cast<double>(stats.hits)));
+    Nan::Set(result, Nan::New<String>("misses").ToLocalChecked(),
+        Nan::New<Number>(static_cast<double>(stats.misses)));
+    Nan::Set(result, Nan::New<String>("diskHits").ToLocalChecked(),
+        Nan::New<Number>(static_cast<double>(stats.disk_hits)));
+    Nan::Set(result, Nan::New<String>("entries").ToLocalChecked(),
+        Nan::New<Number>(static_cast<double>(stats.entries)));
+    Nan::Set(result, Nan::New<String>("memoryUsage").ToLocalChecked(),
+        Nan::New<Number>(static_cast<double>(stats.memory_usage)));
+
+    info.GetReturnValue().Set(result);
+}
+
+NAN_METHOD(JSFilterList::SavePatternCache)
+{
+    Nan::HandleScope scope;
+
+    if (!info[0]->IsString())
+    {
+        Nan::ThrowTypeError("savePatternCache expects a path");
+        return;
+    }
+
+    std::string error;
+    int saved = PatternCache::Save(*Nan::Utf8String(info[0]), &error);
+    if (saved < 0)
+    {
+        Nan::ThrowError(error.c_str());
+        return;
+    }
+
+    info.GetReturnValue().Set(Nan::New<Number>(saved));
+}
+
+NAN_METHOD(JSFilterList::LoadPatternCache)
+{
+    Nan::HandleScope scope;
+
+    if (!info[0]->IsString())
+    {
+        Nan::ThrowTypeError("loadPatternCache expects a path");
+        return;
+    }
+
+    std::string error;
+    int loaded = PatternCache::Load(*Nan::Utf8String(info[0]), &error);
+    if (loaded < 0)
+    {
+        Nan::ThrowError(error.c_str());
+        return;
+    }
+
+    info.GetReturnValue().Set(Nan::New<Number>(loaded));
+}
+
+NAN_METHOD(JSFilterList::ExecStats)
+{
+    Nan::HandleScope scope;
+
+    FilterList::ExecStats stats = FilterList::exec_stats();
+    Local<Object> result = Nan::New<Object>();
+
+    Nan::Set(result, Nan::New<String>("messages").ToLocalChecked(),
+        Nan::New<Number>(static_cast<double>(stats.messages)));
+    Nan::Set(result, Nan::New<String>("asciiMessages").ToLocalChecked(),
+        Nan::New<Number>(static_cast<double>(stats.ascii_messages)));
+    if (Allocations::Counted())
+    {
+        Nan::Set(result, Nan::New<String>("allocations").ToLocalChecked(),
+            Nan::New<Number>(static_cast<double>(Allocations::Count())));
+    }
+
+    info.GetReturnValue().Set(result);
+}
+
+NAN_METHOD(JSFilterList::ExecutorStats)
+{
+    Nan::HandleScope scope;
+
+    Executor::Stats stats = Executor::Get().stats();
+    Local<Object> result = Nan::New<Object>();
+
+    Local<Array> utilisation = Nan::New<Array>(stats.utilisation.size());
+    for (uint32_t i = 0; i < stats.utilisation.size(); i++)
+    {
+        Nan::Set(utilisation, i, Nan::New<Number>(stats.utilisation[i]));
+    }
+
+    Nan::Set(result, Nan::New<String>("threads").ToLocalChecked(),
+        Nan::New<Number>(static_cast<double>(stats.threads)));
+    Nan::Set(result, Nan::New<String>("queueDepth").ToLocalChecked(),
+        Nan::New<Number>(static_cast<double>(stats.queue_depth)));
+    Nan::Set(result, Nan::New<String>("completed").ToLocalChecked(),
+        Nan::New<Number>(static_cast<double>(stats.completed)));
+    Nan::Set(result, Nan::New<String>("meanLatency").ToLocalChecked(),
+        Nan::New<Number>(stats.mean_latency));
+    Nan::Set(result, Nan::New<String>("maxLatency").ToLocalChecked(),
+        Nan::New<Number>(stats.max_latency));
+    Nan::Set(result, Nan::New<String>("utilisation").ToLocalChecked(), utilisation);
+
+    info.GetReturnValue().Set(result);
+}
+
+// Called once for every environment (the main thread and each worker
+// thread) that loads the addon, so the template is not kept between calls
+Local<FunctionTemplate> JSFilterList::Init()
 {
     Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(JSFilterList::New);
     tpl->SetClassName(Nan::New<String>("FilterList").ToLocalChecked());
@@ -432,9 +1168,27 @@ void JSFilterList::Init()
         Nan::New<FunctionTemplate>(JSFilterList::QuoteMeta));
     tpl->Set(Nan::New<String>("checkValidRegex").ToLocalChecked(),
         Nan::New<FunctionTemplate>(JSFilterList::CheckValidRegex));
+    tpl->Set(Nan::New<String>("cacheStats").ToLocalChecked(),
+        Nan::New<FunctionTemplate>(JSFilterList::CacheStats));
+    tpl->Set(Nan::New<String>("savePatternCache").ToLocalChecked(),
+        Nan::New<FunctionTemplate>(JSFilterList::SavePatternCache));
+    tpl->Set(Nan::New<String>("loadPatternCache").ToLocalChecked(),
+        Nan::New<FunctionTemplate>(JSFilterList::LoadPatternCache));
+    tpl->Set(Nan::New<String>("execStats").ToLocalChecked(),
+        Nan::New<FunctionTemplate>(JSFilterList::ExecStats));
+    tpl->Set(Nan::New<String>("executorStats").ToLocalChecked(),
+        Nan::New<FunctionTemplate>(JSFilterList::ExecutorStats));
 
     tpl->InstanceTemplate()->Set(Nan::New<String>("filter").ToLocalChecked(),
         Nan::New<FunctionTemplate>(JSFilterList::FilterString));
+    tpl->InstanceTemplate()->Set(Nan::New<String>("filterMany").ToLocalChecked(),
+        Nan::New<FunctionTemplate>(JSFilterList::FilterMany));
+    tpl->InstanceTemplate()->Set(Nan::New<String>("_filterAsync").ToLocalChecked(),
+        Nan::New<FunctionTemplate>(JSFilterList::FilterAsync));
+    tpl->InstanceTemplate()->Set(Nan::New<String>("_filterManyAsync").ToLocalChecked(),
+        Nan::New<FunctionTemplate>(JSFilterList::FilterManyAsync));
+    tpl->InstanceTemplate()->Set(Nan::New<String>("_filterManyParallel").ToLocalChecked(),
+        Nan::New<FunctionTemplate>(JSFilterList::FilterManyParallel));
     tpl->InstanceTemplate()->Set(Nan::New<String>("pack").ToLocalChecked(),
         Nan::New<FunctionTemplate>(JSFilterList::Pack));
     tpl->InstanceTemplate()->Set(Nan::New<String>("addFilter").ToLocalChecked(),
@@ -445,20 +1199,28 @@ void JSFilterList::Init()
         Nan::New<FunctionTemplate>(JSFilterList::RemoveFilter));
     tpl->InstanceTemplate()->Set(Nan::New<String>("moveFilter").ToLocalChecked(),
         Nan::New<FunctionTemplate>(JSFilterList::MoveFilter));
+    tpl->InstanceTemplate()->Set(Nan::New<String>("setFilters").ToLocalChecked(),
+        Nan::New<FunctionTemplate>(JSFilterList::SetFilters));
+    tpl->InstanceTemplate()->Set(Nan::New<String>("memoryUsage").ToLocalChecked(),
+        Nan::New<FunctionTemplate>(JSFilterList::MemoryUsage));
 
     Nan::SetAccessor(tpl->InstanceTemplate(), Nan::New<String>("length").ToLocalChecked(),
         JSFilterList::GetLength);
 
-    constructor.Reset(tpl);
+    return tpl;
 }
 
-void Init(Local<Object> exports, Local<Object> module)
+// Context aware, so that the addon can be loaded by worker threads as well
+// as the main thread.  Everything it keeps outside of FilterList objects is
+// either per-thread or safe to share between threads; see README.md.
+NODE_MODULE_INIT()
 {
-    JSFilterList::Init();
-    Local<FunctionTemplate> constructor_handle = Nan::New(constructor);
-
-    Nan::Set(module, Nan::New<String>("exports").ToLocalChecked(),
-            Nan::GetFunction(constructor_handle).ToLocalChecked());
-};
+    Local<Object> module_object;
+    if (!Nan::To<Object>(module).ToLocal(&module_object))
+    {
+        return;
+    }
 
-NODE_MODULE(cytubefilters, Init);
+    Nan::Set(module_object, Nan::New<String>("exports").ToLocalChecked(),
+        Nan::GetFunction(JSFilterList::Init()).ToLocalChecked());
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <node.h>
 #include <nan.h>
 
@@ -7,11 +8,13 @@
 
 using node::ObjectWrap;
 using v8::Array;
+using v8::FunctionTemplate;
+using v8::Local;
 
 class JSFilterList : public Nan::ObjectWrap
 {
     public:
-        static void Init();
+        static Local<FunctionTemplate> Init();
 
     private:
         explicit JSFilterList(const FilterList& filter_list);
@@ -19,16 +22,40 @@ class JSFilterList : public Nan::ObjectWrap
 
         static NAN_METHOD(New);
         static NAN_METHOD(FilterString);
+        static NAN_METHOD(FilterMany);
+        static NAN_METHOD(FilterAsync);
+        static NAN_METHOD(FilterManyAsync);
+        static NAN_METHOD(FilterManyParallel);
         static NAN_METHOD(Pack);
         static NAN_METHOD(AddFilter);
         static NAN_METHOD(UpdateFilter);
         static NAN_METHOD(RemoveFilter);
         static NAN_METHOD(MoveFilter);
+        static NAN_METHOD(SetFilters);
+        static NAN_METHOD(MemoryUsage);
 
         static NAN_PROPERTY_GETTER(GetLength);
 
         static NAN_METHOD(QuoteMeta);
         static NAN_METHOD(CheckValidRegex);
-
-        FilterList m_FilterList;
+        static NAN_METHOD(CacheStats);
+        static NAN_METHOD(SavePatternCache);
+        static NAN_METHOD(LoadPatternCache);
+        static NAN_METHOD(ExecStats);
+        static NAN_METHOD(ExecutorStats);
+
+        // The list, prepared, for filtering.  Holding the reference makes
+        // any change made in the meantime go to a copy.
+        std::shared_ptr<const FilterList> shared();
+        // The list, for changing.  If other threads are still using it,
+        // it is copied first.
+        FilterList& writable();
+
+        // A list is never changed while it is shared with filtering on
+        // other threads, which hold their own reference to the list they
+        // started with.  A change then goes to a copy, which shares every
+        // filter that did not change, and the copy takes its place.  Only
+        // the thread that owns this object shares or replaces it, so no
+        // locking is needed.
+        std::shared_ptr<FilterList> m_FilterList;
 };
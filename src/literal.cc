@@ -0,0 +1,327 @@
+#include <cstring>
+#include <string>
+
+#include "./literal.h"
+
+namespace Literal
+{
+    bool HasAsciiCaseFold(unsigned char c)
+    {
+        if (c >= 0x80) return false;
+
+        switch (c | 0x20)
+        {
+            case 'k':
+            case 's':
+                return false;
+            default:
+                return true;
+        }
+    }
+
+    static bool IsAlnum(unsigned char c)
+    {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    // Removes the last (possibly multibyte) character from factor
+    static void PopCharacter(std::string& factor)
+    {
+        while (!factor.empty() && (factor[factor.size() - 1] & 0xc0) == 0x80)
+        {
+            factor.erase(factor.size() - 1);
+        }
+
+        if (!factor.empty())
+        {
+            factor.erase(factor.size() - 1);
+        }
+    }
+
+    static void EndFactor(std::string& current, std::string& best)
+    {
+        if (current.size() > best.size())
+        {
+            best = current;
+        }
+
+        current.clear();
+    }
+
+    // Advances i past a character class starting at source[i] == '['.
+    // Returns false if the class is not terminated.
+    static bool SkipClass(const std::string& source, size_t& i)
+    {
+        i++;
+        if (i < source.size() && source[i] == '^') i++;
+
+        while (i < source.size())
+        {
+            char c = source[i];
+            if (c == '\\')
+            {
+                i += 2;
+            }
+            else if (c == '[' && i + 1 < source.size() && strchr(":.=", source[i + 1]) != NULL)
+            {
+                // POSIX class such as [:alpha:]
+                size_t end = source.find(std::string(1, source[i + 1]) + "]", i + 2);
+                if (end == std::string::npos) return false;
+                i = end + 2;
+            }
+            else if (c == ']')
+            {
+                i++;
+                return true;
+            }
+            else
+            {
+                i++;
+            }
+        }
+
+        return false;
+    }
+
+    // Advances i past a group starting at source[i] == '('.  Returns false if
+    // the group is not terminated.
+    static bool SkipGroup(const std::string& source, size_t& i)
+    {
+        int depth = 0;
+        while (i < source.size())
+        {
+            char c = source[i];
+            if (c == '\\')
+            {
+                i += 2;
+            }
+            else if (c == '[')
+            {
+                if (!SkipClass(source, i)) return false;
+            }
+            else
+            {
+                if (c == '(') depth++;
+                if (c == ')' && --depth == 0)
+                {
+                    i++;
+                    return true;
+                }
+
+                i++;
+            }
+        }
+
+        return false;
+    }
+
+    // If source[i] starts a counted quantifier such as {2} or {1,3}, advances
+    // i past it and returns true.
+    static bool SkipCountedQuantifier(const std::string& source, size_t& i)
+    {
+        size_t j = i + 1;
+        size_t digits = 0;
+        while (j < source.size() && source[j] >= '0' && source[j] <= '9') j++, digits++;
+        if (digits == 0) return false;
+
+        if (j < source.size() && source[j] == ',')
+        {
+            j++;
+            while (j < source.size() && source[j] >= '0' && source[j] <= '9') j++;
+        }
+
+        if (j >= source.size() || source[j] != '}') return false;
+
+        i = j + 1;
+        return true;
+    }
+
+    std::string RequiredFactor(const std::string& source, bool caseless)
+    {
+        std::string best, current;
+        size_t i = 0;
+
+        while (i < source.size())
+        {
+            unsigned char c = source[i];
+            switch (c)
+            {
+                case '|':
+                    // Top-level alternation: no single factor is required
+                    return "";
+                case '(':
+                    // Inline options such as (?i) change how the rest of the
+                    // pattern matches
+                    if (source.compare(i, 2, "(?") == 0 && i + 2 < source.size() &&
+                        strchr("imsxJUX-", source[i + 2]) != NULL)
+                    {
+                        return "";
+                    }
+
+                    EndFactor(current, best);
+                    if (!SkipGroup(source, i)) return "";
+                    break;
+                case '[':
+                    EndFactor(current, best);
+                    if (!SkipClass(source, i)) return "";
+                    break;
+                case '*':
+                case '?':
+                    // The preceding atom is optional
+                    PopCharacter(current);
+                    EndFactor(current, best);
+                    i++;
+                    break;
+                case '+':
+                    // The preceding atom is required, but what follows it is
+                    // not adjacent to it
+                    EndFactor(current, best);
+                    i++;
+                    break;
+                case '{':
+                    PopCharacter(current);
+                    EndFactor(current, best);
+                    if (!SkipCountedQuantifier(source, i)) i++;
+                    break;
+                case '\\':
+                    if (i + 1 >= source.size()) return "";
+
+                    c = source[i + 1];
+                    if (c >= 0x80)
+                    {
+                        return "";
+                    }
+                    else if (!IsAlnum(c))
+                    {
+                        // Escaped punctuation is a literal
+                        if (caseless && !HasAsciiCaseFold(c))
+                        {
+                            EndFactor(current, best);
+                        }
+                        else
+                        {
+                            current.push_back(c);
+                        }
+                    }
+                    else if (strchr("dDwWsSbBAzZGhHvVRXK", c) != NULL)
+                    {
+                        // Escapes without arguments that match no fixed text
+                        EndFactor(current, best);
+                    }
+                    else
+                    {
+                        // Anything else (\x, \u, \p, backreferences, \Q, ...)
+                        // would need a real parser
+                        return "";
+                    }
+
+                    i += 2;
+                    break;
+                case '.':
+                case '^':
+                case '$':
+                case ')':
+                case ']':
+                case '}':
+                    EndFactor(current, best);
+                    i++;
+                    break;
+                default:
+                    if (caseless && !HasAsciiCaseFold(c))
+                    {
+                        // Skip the whole character, not just this byte
+                        EndFactor(current, best);
+                        i++;
+                        while (i < source.size() && (source[i] & 0xc0) == 0x80) i++;
+                    }
+                    else
+                    {
+                        current.push_back(c);
+                        i++;
+                    }
+                    break;
+            }
+        }
+
+        EndFactor(current, best);
+        return best;
+    }
+
+    bool IsPureLiteral(const std::string& source, std::string* literal)
+    {
+        literal->clear();
+        for (size_t i = 0; i < source.size(); i++)
+        {
+            unsigned char c = source[i];
+            if (c == '\\')
+            {
+                if (i + 1 >= source.size()) return false;
+
+                c = source[++i];
+                if (c >= 0x80 || IsAlnum(c)) return false;
+            }
+            else if (strchr("^$.|?*+()[]{}", c) != NULL)
+            {
+                return false;
+            }
+
+            literal->push_back(c);
+        }
+
+        return !literal->empty();
+    }
+
+    static unsigned char FoldByte(unsigned char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? (c | 0x20) : c;
+    }
+
+    size_t Find(const std::string& haystack, size_t start,
+        const std::string& needle, bool caseless)
+    {
+        if (needle.empty() || start > haystack.size() ||
+            haystack.size() - start < needle.size())
+        {
+            return std::string::npos;
+        }
+
+        const char *data = haystack.data();
+        const char *p = data + start;
+        // Last position at which needle still fits
+        const char *last = data + haystack.size() - needle.size();
+
+        if (!caseless)
+        {
+            while (p <= last)
+            {
+                p = static_cast<const char*>(memchr(p, needle[0], last - p + 1));
+                if (p == NULL) break;
+                if (memcmp(p + 1, needle.data() + 1, needle.size() - 1) == 0)
+                {
+                    return p - data;
+                }
+
+                p++;
+            }
+
+            return std::string::npos;
+        }
+
+        unsigned char first = FoldByte(needle[0]);
+        for (; p <= last; p++)
+        {
+            if (FoldByte(*p) != first) continue;
+
+            size_t i = 1;
+            while (i < needle.size() &&
+                FoldByte(p[i]) == FoldByte(needle[i]))
+            {
+                i++;
+            }
+
+            if (i == needle.size()) return p - data;
+        }
+
+        return std::string::npos;
+    }
+}
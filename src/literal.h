@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+// Static analysis of filter sources, used to avoid running PCRE at all when
+// the literal text a pattern needs is not present in a message.
+namespace Literal
+{
+    // Returns a string that must occur in the subject for source to match,
+    // or an empty string if none could be determined.  The analysis is
+    // conservative: anything it does not understand ends the current factor
+    // or gives up.  For caseless patterns the factor only contains bytes
+    // that PCRE folds within ASCII, so ASCII case-insensitive comparison of
+    // the factor is exact.
+    std::string RequiredFactor(const std::string& source, bool caseless);
+
+    // True if caseless matching of byte c in UTF-8 mode can only ever match
+    // its ASCII upper- or lowercase form.  Not true for k and s, which also
+    // match U+212A KELVIN SIGN and U+017F LATIN SMALL LETTER LONG S.
+    bool HasAsciiCaseFold(unsigned char c);
+
+    // True if source matches exactly one fixed string, made up of ordinary
+    // characters and escaped punctuation (as produced by RE::QuoteMeta).
+    // The unescaped string is stored in literal.
+    bool IsPureLiteral(const std::string& source, std::string* literal);
+
+    // Returns the offset of the first occurrence of needle in haystack at
+    // or after start, or std::string::npos.  If caseless is set, ASCII
+    // letters compare case-insensitively.
+    size_t Find(const std::string& haystack, size_t start,
+        const std::string& needle, bool caseless);
+}
@@ -0,0 +1,207 @@
+#include <cstring>
+#include <string>
+#include <vector>
+#include <pcre.h>
+
+#include "./filter.h"
+#include "./literalrun.h"
+#include "./pattern.h"
+
+// Fits m_Dispatch; longer runs are split
+#define MAX_MEMBERS 255
+
+static unsigned char FoldByte(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (c | 0x20) : c;
+}
+
+// Marks every byte of text in set, in both cases if caseless
+static void AddBytes(bool *set, const std::string& text, bool caseless)
+{
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        unsigned char c = text[i];
+        set[c] = true;
+        if (caseless && FoldByte(c) >= 'a' && FoldByte(c) <= 'z')
+        {
+            set[FoldByte(c)] = true;
+            set[FoldByte(c) & ~0x20] = true;
+        }
+    }
+}
+
+static bool IsCaseless(const Filter& filter)
+{
+    return (filter.pattern()->flags() & PCRE_CASELESS) != 0;
+}
+
+// What filter writes in place of each match.  Only \0 can vary between
+// matches, and then only in case, because the match is the literal itself.
+static std::string SampleOutput(const Filter& filter)
+{
+    const std::string& literal = *filter.pattern()->literal();
+    int vec[2] = { 0, static_cast<int>(literal.size()) };
+
+    std::string out;
+    filter.rewrite().append(&out, literal.data(), vec, 1);
+    return out;
+}
+
+LiteralRun::LiteralRun() : m_LastErases(false), m_NeedsAscii(false)
+{
+    memset(this->m_Dispatch, 0, sizeof(this->m_Dispatch));
+    memset(this->m_Used, 0, sizeof(this->m_Used));
+}
+
+bool LiteralRun::can_append(const Filter& filter) const
+{
+    const Pattern *pattern = filter.pattern();
+    if (pattern == NULL || pattern->literal() == NULL || !filter.global())
+    {
+        return false;
+    }
+
+    if (this->m_Members.size() >= MAX_MEMBERS || this->m_LastErases)
+    {
+        return false;
+    }
+
+    bool matched[256] = { false };
+    AddBytes(matched, *pattern->literal(), IsCaseless(filter));
+    for (int c = 0; c < 256; c++)
+    {
+        if (matched[c] && this->m_Used[c]) return false;
+    }
+
+    return true;
+}
+
+void LiteralRun::append(const Filter& filter)
+{
+    const Pattern *pattern = filter.pattern();
+    Member member;
+    member.literal = *pattern->literal();
+    member.caseless = IsCaseless(filter);
+    member.rewrite = filter.rewrite();
+    this->m_Members.push_back(member);
+
+    bool first[256] = { false };
+    AddBytes(first, member.literal.substr(0, 1), member.caseless);
+    for (int c = 0; c < 256; c++)
+    {
+        if (first[c]) this->m_Dispatch[c] = this->m_Members.size();
+    }
+
+    std::string output = SampleOutput(filter);
+    AddBytes(this->m_Used, member.literal, member.caseless);
+    AddBytes(this->m_Used, output, member.caseless);
+    this->m_LastErases = output.empty();
+
+    if (pattern->literal_needs_ascii())
+    {
+        this->m_NeedsAscii = true;
+    }
+}
+
+size_t LiteralRun::size() const
+{
+    return this->m_Members.size();
+}
+
+bool LiteralRun::needs_ascii() const
+{
+    return this->m_NeedsAscii;
+}
+
+static bool MatchesAt(const std::string& input, size_t offset,
+    const std::string& literal, bool caseless)
+{
+    if (input.size() - offset < literal.size())
+    {
+        return false;
+    }
+
+    const char *p = input.data() + offset;
+    if (!caseless)
+    {
+        return memcmp(p, literal.data(), literal.size()) == 0;
+    }
+
+    for (size_t i = 0; i < literal.size(); i++)
+    {
+        if (FoldByte(p[i]) != FoldByte(literal[i])) return false;
+    }
+
+    return true;
+}
+
+bool LiteralRun::exec(std::string* input, unsigned int length_limit, bool* changed,
+    std::string* scratch) const
+{
+    if (input->length() >= length_limit)
+    {
+        return false;
+    }
+
+    // Change in length caused by each member, to check afterwards that
+    // none of them would have reached length_limit when run alone
+    static thread_local std::vector<long> growth;
+    growth.assign(this->m_Members.size(), 0);
+    std::string& out = *scratch;
+    out.clear();
+    size_t start = 0;
+    size_t i = 0;
+    *changed = false;
+
+    while (i < input->size())
+    {
+        unsigned char index = this->m_Dispatch[static_cast<unsigned char>((*input)[i])];
+        if (index == 0)
+        {
+            i++;
+            continue;
+        }
+
+        const Member& member = this->m_Members[index - 1];
+        if (!MatchesAt(*input, i, member.literal, member.caseless))
+        {
+            i++;
+            continue;
+        }
+
+        int vec[2] = { static_cast<int>(i), static_cast<int>(i + member.literal.size()) };
+        out.append(*input, start, i - start);
+        size_t before = out.size();
+        member.rewrite.append(&out, input->data(), vec, 1);
+        growth[index - 1] += static_cast<long>(out.size() - before) -
+            static_cast<long>(member.literal.size());
+
+        i += member.literal.size();
+        start = i;
+        *changed = true;
+    }
+
+    if (!*changed)
+    {
+        return true;
+    }
+
+    // GlobalReplace stops early once its input or output reaches
+    // length_limit.  Every output prefix is no longer than the whole output,
+    // so if no intermediate message reaches the limit, none of the members
+    // would have stopped early.
+    long length = input->length();
+    for (size_t m = 0; m < growth.size(); m++)
+    {
+        length += growth[m];
+        if (length >= static_cast<long>(length_limit))
+        {
+            *changed = false;
+            return false;
+        }
+    }
+
+    out.append(*input, start, std::string::npos);
+    input->swap(out);
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "./filter.h"
+#include "./replacement.h"
+
+// A run of adjacent global plain-string filters (see Pattern::literal) that
+// can be applied in one pass over a message instead of one pass each.
+//
+// That is only equivalent when the filters cannot affect each other: no
+// filter may match any byte that an earlier filter in the run matches or
+// writes, so that its matches are the same before and after the earlier
+// filters have run, and no filter except the last may replace its matches
+// with nothing, which could join text into a new match.
+class LiteralRun
+{
+    public:
+        LiteralRun();
+
+        // True if filter may be applied after the filters already in the
+        // run, in the same pass
+        bool can_append(const Filter& filter) const;
+        void append(const Filter& filter);
+
+        size_t size() const;
+        // True if some member is only equivalent to PCRE on ASCII input
+        // (see Pattern::literal_needs_ascii)
+        bool needs_ascii() const;
+
+        // Applies every member to input, which must be valid UTF-8.  Returns
+        // false, leaving input untouched, if length_limit would have cut
+        // one of the members short when run on its own; the members must
+        // then be run one at a time.  Otherwise sets changed to whether any
+        // member matched.  The result is built in scratch, which is then
+        // swapped with input.
+        bool exec(std::string* input, unsigned int length_limit, bool* changed,
+            std::string* scratch) const;
+
+    private:
+        struct Member
+        {
+            std::string literal;
+            bool caseless;
+            Replacement rewrite;
+        };
+
+        std::vector<Member> m_Members;
+        // For each byte, one more than the index of the member whose literal
+        // can start with it, or 0
+        unsigned char m_Dispatch[256];
+        // Bytes that some member can match or write
+        bool m_Used[256];
+        // True if the last member can replace a match with nothing
+        bool m_LastErases;
+        bool m_NeedsAscii;
+};
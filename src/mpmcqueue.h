@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+
+// Bounded lock-free queue for any number of producers and consumers.  Each
+// cell carries a sequence number saying whether it is ready to be written
+// or read on the current lap, so producers and consumers only contend on
+// their own position counter.  The capacity is rounded up to a power of 2.
+template<typename T>
+class MpmcQueue
+{
+    public:
+        explicit MpmcQueue(size_t capacity)
+        {
+            size_t size = 2;
+            while (size < capacity) size <<= 1;
+
+            this->m_Cells.reset(new Cell[size]);
+            this->m_Mask = size - 1;
+            for (size_t i = 0; i < size; i++)
+            {
+                this->m_Cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+
+            this->m_Push.store(0, std::memory_order_relaxed);
+            this->m_Pop.store(0, std::memory_order_relaxed);
+        }
+
+        // Returns false if the queue is full
+        bool push(const T& value)
+        {
+            size_t pos = this->m_Push.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell& cell = this->m_Cells[pos & this->m_Mask];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                long diff = static_cast<long>(sequence) - static_cast<long>(pos);
+                if (diff == 0)
+                {
+                    if (this->m_Push.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed))
+                    {
+                        cell.value = value;
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = this->m_Push.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Returns false if the queue is empty
+        bool pop(T& value)
+        {
+            size_t pos = this->m_Pop.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell& cell = this->m_Cells[pos & this->m_Mask];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                long diff = static_cast<long>(sequence) - static_cast<long>(pos + 1);
+                if (diff == 0)
+                {
+                    if (this->m_Pop.compare_exchange_weak(pos, pos + 1,
+                        std::memory_order_relaxed))
+                    {
+                        value = cell.value;
+                        cell.sequence.store(pos + this->m_Mask + 1,
+                            std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = this->m_Pop.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T value;
+        };
+
+        std::unique_ptr<Cell[]> m_Cells;
+        size_t m_Mask;
+        // Kept on separate cache lines so producers and consumers do not
+        // invalidate each other's position
+        alignas(64) std::atomic<size_t> m_Push;
+        alignas(64) std::atomic<size_t> m_Pop;
+};
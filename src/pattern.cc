@@ -0,0 +1,284 @@
+#include <cstring>
+#include <pcrecpp.h>
+
+#include "./literal.h"
+#include "./pattern.h"
+
+#define MATCH_LIMIT 5000
+
+static pcrecpp::RE_Options CompileOptions(int flags)
+{
+    pcrecpp::RE_Options options(flags);
+    options.set_match_limit(MATCH_LIMIT);
+    options.set_study(true);
+    options.set_jit(true);
+    // Filters only use Replace and GlobalReplace, never FullMatch
+    options.set_full_match(false);
+
+    return options;
+}
+
+Pattern::Pattern(const std::string& source, int flags)
+    : m_RE(source, CompileOptions(flags)),
+    m_Flags(flags)
+{
+    this->derive_prefilter();
+    this->compile_ascii_variant();
+    this->detect_literal();
+}
+
+Pattern::Pattern(const std::string& source, int flags, pcre *compiled,
+    pcre *ascii_compiled)
+    : m_RE(source, CompileOptions(flags), compiled),
+    m_Flags(flags)
+{
+    this->derive_prefilter();
+    if (ascii_compiled != NULL)
+    {
+        this->m_AsciiRE.reset(new pcrecpp::RE(source,
+            CompileOptions(flags & ~PCRE_UTF8), ascii_compiled));
+    }
+    this->detect_literal();
+}
+
+const std::string& Pattern::source() const
+{
+    return this->m_RE.pattern();
+}
+
+int Pattern::flags() const
+{
+    return this->m_Flags;
+}
+
+const pcrecpp::RE& Pattern::re() const
+{
+    return this->m_RE;
+}
+
+const pcrecpp::RE* Pattern::ascii_re() const
+{
+    return this->m_AsciiRE.get();
+}
+
+size_t Pattern::memory_usage() const
+{
+    size_t usage = this->m_RE.MemoryUsage();
+    if (this->m_AsciiRE)
+    {
+        usage += this->m_AsciiRE->MemoryUsage();
+    }
+
+    return usage;
+}
+
+const std::string& Pattern::required_literal() const
+{
+    return this->m_RequiredLiteral;
+}
+
+// True if source means the same with and without PCRE_UTF8, as long as the
+// subject is ASCII.  Without UCP, classes such as \w and \d and case folding
+// are ASCII-only in both modes, so what remains are non-ASCII literals,
+// Unicode properties, single-byte matching and verbs such as (*UTF8).
+// Escapes like \x{100} that only exist in UTF-8 mode fail to compile.
+static bool IsAsciiEquivalent(const std::string& source, int flags)
+{
+    if (!(flags & PCRE_UTF8) || (flags & PCRE_UCP)) return false;
+
+    for (size_t i = 0; i < source.size(); i++)
+    {
+        unsigned char c = source[i];
+        if (c >= 0x80) return false;
+        if (c == '(' && source.compare(i, 2, "(*") == 0) return false;
+
+        if (c == '\\' && i + 1 < source.size())
+        {
+            switch (source[++i])
+            {
+                case 'p':
+                case 'P':
+                case 'X':
+                case 'C':
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void Pattern::compile_ascii_variant()
+{
+    if (!this->m_RE.error().empty() ||
+        !IsAsciiEquivalent(this->m_RE.pattern(), this->m_Flags))
+    {
+        return;
+    }
+
+    this->m_AsciiRE.reset(new pcrecpp::RE(this->m_RE.pattern(),
+        CompileOptions(this->m_Flags & ~PCRE_UTF8)));
+    if (!this->m_AsciiRE->error().empty())
+    {
+        this->m_AsciiRE.reset();
+    }
+}
+
+const std::string* Pattern::literal() const
+{
+    return this->m_IsLiteral ? &this->m_Literal : NULL;
+}
+
+bool Pattern::literal_needs_ascii() const
+{
+    return this->m_LiteralNeedsAscii;
+}
+
+void Pattern::detect_literal()
+{
+    this->m_IsLiteral = false;
+    this->m_LiteralNeedsAscii = false;
+
+    const int known = PCRE_UTF8 | PCRE_JAVASCRIPT_COMPAT | PCRE_CASELESS |
+        PCRE_MULTILINE | PCRE_NO_AUTO_CAPTURE;
+    if (!this->m_RE.error().empty() || (this->m_Flags & ~known) ||
+        !Literal::IsPureLiteral(this->m_RE.pattern(), &this->m_Literal))
+    {
+        this->m_Literal.clear();
+        return;
+    }
+
+    if (this->m_Flags & PCRE_CASELESS)
+    {
+        for (size_t i = 0; i < this->m_Literal.size(); i++)
+        {
+            unsigned char c = this->m_Literal[i];
+            if (c >= 0x80)
+            {
+                // Non-ASCII case folding is left to PCRE
+                this->m_Literal.clear();
+                return;
+            }
+
+            if (!Literal::HasAsciiCaseFold(c))
+            {
+                this->m_LiteralNeedsAscii = true;
+            }
+        }
+    }
+
+    this->m_IsLiteral = true;
+}
+
+static bool IsCaselessLetter(int c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+void Pattern::derive_prefilter()
+{
+    this->m_MinLength = 0;
+    this->m_FirstByte = -1;
+    this->m_RequiredByte = -1;
+    this->m_HasStartBits = false;
+    this->m_Caseless = false;
+
+    const pcre *re = this->m_RE.compiled();
+    const pcre_extra *extra = this->m_RE.extra();
+    if (re == NULL) return;
+
+    this->m_RequiredLiteral = Literal::RequiredFactor(this->m_RE.pattern(),
+        (this->m_Flags & PCRE_CASELESS) != 0);
+
+    // PCRE does not report whether the first/required bytes are caseless.
+    // Assume they are whenever the pattern could have turned on caseless
+    // matching, and give up on bytes whose other case we cannot know.
+    bool caseless = (this->m_Flags & PCRE_CASELESS) ||
+        this->m_RE.pattern().find("(?") != std::string::npos;
+    this->m_Caseless = caseless;
+
+    int min_length;
+    if (pcre_fullinfo(re, extra, PCRE_INFO_MINLENGTH, &min_length) == 0 &&
+        min_length > 0)
+    {
+        // Counted in characters, which is a lower bound on bytes
+        this->m_MinLength = min_length;
+    }
+
+    int first_flags;
+    unsigned int first;
+    if (pcre_fullinfo(re, extra, PCRE_INFO_FIRSTCHARACTERFLAGS, &first_flags) == 0 &&
+        first_flags == 1 &&
+        pcre_fullinfo(re, extra, PCRE_INFO_FIRSTCHARACTER, &first) == 0 &&
+        (!caseless || first < 128))
+    {
+        this->m_FirstByte = first;
+    }
+
+    int required_flags;
+    unsigned int required;
+    if (pcre_fullinfo(re, extra, PCRE_INFO_REQUIREDCHARFLAGS, &required_flags) == 0 &&
+        required_flags == 1 &&
+        pcre_fullinfo(re, extra, PCRE_INFO_REQUIREDCHAR, &required) == 0 &&
+        (!caseless || required < 128))
+    {
+        this->m_RequiredByte = required;
+    }
+
+    const unsigned char *start_bits;
+    if (this->m_FirstByte < 0 &&
+        pcre_fullinfo(re, extra, PCRE_INFO_FIRSTTABLE, &start_bits) == 0 &&
+        start_bits != NULL)
+    {
+        this->m_HasStartBits = true;
+        memcpy(this->m_StartBits, start_bits, sizeof(this->m_StartBits));
+    }
+}
+
+static bool ContainsByte(const char *data, size_t length, int c, bool caseless)
+{
+    if (caseless && IsCaselessLetter(c))
+    {
+        return memchr(data, c | 0x20, length) != NULL ||
+            memchr(data, c & ~0x20, length) != NULL;
+    }
+
+    return memchr(data, c, length) != NULL;
+}
+
+bool Pattern::may_match(const std::string& subject) const
+{
+    const char *data = subject.data();
+    size_t length = subject.size();
+
+    if (length < this->m_MinLength)
+    {
+        return false;
+    }
+
+    if (this->m_FirstByte >= 0 &&
+        !ContainsByte(data, length, this->m_FirstByte, this->m_Caseless))
+    {
+        return false;
+    }
+
+    if (this->m_RequiredByte >= 0 &&
+        !ContainsByte(data, length, this->m_RequiredByte, this->m_Caseless))
+    {
+        return false;
+    }
+
+    if (this->m_HasStartBits)
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(data);
+        const unsigned char *end = p + length;
+        for (; p < end; p++)
+        {
+            if (this->m_StartBits[*p >> 3] & (1 << (*p & 7))) return true;
+        }
+
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <pcrecpp.h>
+
+// The compiled, immutable form of a filter's source.  Patterns are shared
+// between copies of a Filter, so copying or moving filters around never
+// recompiles the regex.
+class Pattern
+{
+    public:
+        Pattern(const std::string& source, int flags);
+        // Adopts previously compiled forms of source (see PatternCache::Load):
+        // compiled with flags, and ascii_compiled without PCRE_UTF8, or NULL
+        // if the pattern has no ASCII variant (see ascii_re)
+        Pattern(const std::string& source, int flags, pcre *compiled,
+            pcre *ascii_compiled);
+
+        Pattern(const Pattern&) = delete;
+        Pattern& operator=(const Pattern&) = delete;
+
+        const std::string& source() const;
+        int flags() const;
+        const pcrecpp::RE& re() const;
+        // The pattern compiled without PCRE_UTF8, which matches exactly the
+        // same way on pure ASCII subjects, or NULL if the source uses
+        // anything whose meaning depends on UTF-8 mode.
+        const pcrecpp::RE* ascii_re() const;
+
+        size_t memory_usage() const;
+
+        // Cheap check against what PCRE learned about the pattern when
+        // compiling and studying it (minimum length, first and required
+        // bytes, possible starting bytes).  False means the pattern cannot
+        // match anywhere in subject, so pcre_exec need not be called.
+        bool may_match(const std::string& subject) const;
+
+        // A literal that must occur in any match, or empty if none is known.
+        // Compare it ASCII case-insensitively if flags() has PCRE_CASELESS.
+        const std::string& required_literal() const;
+
+        // If the source matches one fixed string, that string, which can be
+        // searched for directly instead of with PCRE.  Otherwise NULL.
+        // Compare it ASCII case-insensitively if flags() has PCRE_CASELESS.
+        const std::string* literal() const;
+        // True if searching for literal() is only equivalent to PCRE on
+        // ASCII subjects, because caseless k and s also match non-ASCII
+        // characters.
+        bool literal_needs_ascii() const;
+
+    private:
+        void derive_prefilter();
+        void compile_ascii_variant();
+        void detect_literal();
+
+        pcrecpp::RE m_RE;
+        std::unique_ptr<pcrecpp::RE> m_AsciiRE;
+        int m_Flags;
+
+        size_t m_MinLength;
+        int m_FirstByte;
+        int m_RequiredByte;
+        bool m_Caseless;
+        bool m_HasStartBits;
+        unsigned char m_StartBits[32];
+        std::string m_RequiredLiteral;
+
+        bool m_IsLiteral;
+        bool m_LiteralNeedsAscii;
+        std::string m_Literal;
+};
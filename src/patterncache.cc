@@ -0,0 +1,471 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <pcre.h>
+
+#include "./pattern.h"
+#include "./patterncache.h"
+
+#define CACHE_FILE_MAGIC "CYTUBEFILTERS-PATTERNS-3"
+// Length of the part of the magic shared by every version of the format
+#define CACHE_FILE_MAGIC_PREFIX_LENGTH 23
+// Upper bound on any single string in a cache file, to reject corrupt sizes
+#define CACHE_FILE_MAX_STRING (16 * 1024 * 1024)
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+
+namespace PatternCache
+{
+    typedef std::pair<std::string, int> Key;
+
+    // Bytecode of a pattern and of its ASCII variant, which is empty if it
+    // has none
+    struct Code
+    {
+        std::string code;
+        std::string ascii_code;
+
+        size_t size() const
+        {
+            return code.size() + ascii_code.size();
+        }
+    };
+
+    struct State
+    {
+        std::mutex mutex;
+        std::map<Key, std::weak_ptr<const Pattern> > entries;
+        // Bytecode read by Load(), in host byte order, until a pattern
+        // adopts it
+        std::map<Key, Code> stored;
+        size_t stored_size;
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t disk_hits;
+        size_t memory_usage;
+    };
+
+    // Never destroyed, so that filters released during process teardown
+    // can still safely remove themselves from the cache.
+    static State& GetState()
+    {
+        static State *state = new State();
+        return *state;
+    }
+
+    static void Release(const Pattern *pattern)
+    {
+        State& state = GetState();
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.memory_usage -= pattern->memory_usage();
+
+            // The entry may already have been replaced by a fresh compile of
+            // the same key while we were waiting for the lock.
+            std::map<Key, std::weak_ptr<const Pattern> >::iterator it =
+                state.entries.find(Key(pattern->source(), pattern->flags()));
+            if (it != state.entries.end() && it->second.expired())
+            {
+                state.entries.erase(it);
+            }
+        }
+
+        delete pattern;
+    }
+
+    static pcre* Adopt(const std::string& code)
+    {
+        pcre *compiled = static_cast<pcre*>((*pcre_malloc)(code.size()));
+        if (compiled != NULL)
+        {
+            memcpy(compiled, code.data(), code.size());
+        }
+
+        return compiled;
+    }
+
+    static Pattern* FromStored(const Key& key, const Code& code)
+    {
+        pcre *compiled = Adopt(code.code);
+        pcre *ascii_compiled = NULL;
+        if (compiled != NULL && !code.ascii_code.empty())
+        {
+            ascii_compiled = Adopt(code.ascii_code);
+            if (ascii_compiled == NULL)
+            {
+                (*pcre_free)(compiled);
+                compiled = NULL;
+            }
+        }
+
+        if (compiled == NULL)
+        {
+            return NULL;
+        }
+
+        return new Pattern(key.first, key.second, compiled, ascii_compiled);
+    }
+
+    // Compiling takes far longer than anything else here, so it is done
+    // without the lock held, to not hold up other threads' lookups and
+    // releases.  Two threads missing on the same key at once both compile,
+    // and the later one adopts the earlier one's pattern.
+    std::shared_ptr<const Pattern> Get(const std::string& source, int flags)
+    {
+        State& state = GetState();
+        Key key(source, flags);
+        Code code;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+
+            std::shared_ptr<const Pattern> pattern = state.entries[key].lock();
+            if (pattern)
+            {
+                state.hits++;
+                return pattern;
+            }
+
+            state.misses++;
+            std::map<Key, Code>::iterator stored = state.stored.find(key);
+            if (stored != state.stored.end())
+            {
+                code.code.swap(stored->second.code);
+                code.ascii_code.swap(stored->second.ascii_code);
+                state.stored_size -= code.size();
+                state.stored.erase(stored);
+            }
+        }
+
+        Pattern *created = NULL;
+        bool from_disk = false;
+        if (!code.code.empty())
+        {
+            created = FromStored(key, code);
+            from_disk = created != NULL;
+        }
+
+        if (created == NULL)
+        {
+            created = new Pattern(source, flags);
+        }
+
+        std::shared_ptr<const Pattern> pattern;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+
+            std::weak_ptr<const Pattern>& entry = state.entries[key];
+            pattern = entry.lock();
+            if (!pattern)
+            {
+                if (from_disk)
+                {
+                    state.disk_hits++;
+                }
+
+                pattern = std::shared_ptr<const Pattern>(created, Release);
+                state.memory_usage += pattern->memory_usage();
+                entry = pattern;
+                return pattern;
+            }
+        }
+
+        // Another thread got there first
+        delete created;
+        return pattern;
+    }
+
+    Stats GetStats()
+    {
+        State& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+
+        Stats stats;
+        stats.hits = state.hits;
+        stats.misses = state.misses;
+        stats.disk_hits = state.disk_hits;
+        stats.entries = state.entries.size();
+        stats.memory_usage = state.memory_usage + state.stored_size;
+
+        return stats;
+    }
+
+    // Identifies the PCRE build that produced a cache file.  Bytecode is only
+    // portable between identical versions and configurations.
+    static std::string Fingerprint()
+    {
+        int utf8 = 0, ucp = 0, newline = 0, link_size = 0, bsr = 0;
+        pcre_config(PCRE_CONFIG_UTF8, &utf8);
+        pcre_config(PCRE_CONFIG_UNICODE_PROPERTIES, &ucp);
+        pcre_config(PCRE_CONFIG_NEWLINE, &newline);
+        pcre_config(PCRE_CONFIG_LINK_SIZE, &link_size);
+        pcre_config(PCRE_CONFIG_BSR, &bsr);
+
+        std::ostringstream oss;
+        oss << pcre_version()
+            << " utf8=" << utf8
+            << " ucp=" << ucp
+            << " newline=" << newline
+            << " link=" << link_size
+            << " bsr=" << bsr
+            << " ptr=" << sizeof(void*);
+
+        return oss.str();
+    }
+
+    // One step of FNV-1a over the given bytes
+    static uint64_t Fnv1a(uint64_t hash, const char *data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= static_cast<unsigned char>(data[i]);
+            hash *= 1099511628211ULL;
+        }
+
+        return hash;
+    }
+
+    // FNV-1a over the pattern source and flags
+    static uint64_t Hash(const std::string& source, int flags)
+    {
+        uint64_t hash = Fnv1a(FNV_OFFSET_BASIS, source.data(), source.size());
+        for (size_t i = 0; i < sizeof(flags); i++)
+        {
+            char byte = (static_cast<unsigned int>(flags) >> (8 * i)) & 0xff;
+            hash = Fnv1a(hash, &byte, 1);
+        }
+
+        return hash;
+    }
+
+    // FNV-1a over both variants' bytecode, so that a corrupt entry is
+    // recompiled rather than run.  Validate only checks the header.
+    static uint64_t Checksum(const Code& code)
+    {
+        uint32_t size = code.code.size();
+        uint64_t hash = Fnv1a(FNV_OFFSET_BASIS, reinterpret_cast<const char*>(&size),
+            sizeof(size));
+        hash = Fnv1a(hash, code.code.data(), code.code.size());
+        return Fnv1a(hash, code.ascii_code.data(), code.ascii_code.size());
+    }
+
+    // The smallest bytecode pcre_compile can produce, which is at least the
+    // size of the header that pcre_pattern_to_host_byte_order inspects.
+    static size_t ComputeMinimumCodeSize()
+    {
+        size_t minimum = 0;
+        const char *error;
+        int offset;
+        pcre *empty = pcre_compile("", 0, &error, &offset, NULL);
+        if (empty != NULL)
+        {
+            pcre_fullinfo(empty, NULL, PCRE_INFO_SIZE, &minimum);
+            (*pcre_free)(empty);
+        }
+
+        return minimum;
+    }
+
+    static size_t MinimumCodeSize()
+    {
+        static const size_t minimum = ComputeMinimumCodeSize();
+        return minimum;
+    }
+
+    // Checks that code is a complete, compatible pattern compiled with flags,
+    // and in UTF-8 mode only if flags has PCRE_UTF8.  Converts it to host
+    // byte order in place.
+    static bool Validate(std::string& code, int flags)
+    {
+        size_t minimum = MinimumCodeSize();
+        if (minimum == 0 || code.size() < minimum) return false;
+
+        pcre *re = reinterpret_cast<pcre*>(&code[0]);
+        if (pcre_pattern_to_host_byte_order(re, NULL, NULL) != 0) return false;
+
+        size_t size;
+        unsigned long options;
+        if (pcre_fullinfo(re, NULL, PCRE_INFO_SIZE, &size) != 0) return false;
+        if (size != code.size())                                   return false;
+        if (pcre_fullinfo(re, NULL, PCRE_INFO_OPTIONS, &options) != 0) return false;
+        if ((options & flags) != static_cast<unsigned long>(flags))  return false;
+        if ((options ^ flags) & PCRE_UTF8)                          return false;
+
+        return true;
+    }
+
+    static void WriteU32(std::ostream& out, uint32_t value)
+    {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    static void WriteString(std::ostream& out, const std::string& value)
+    {
+        WriteU32(out, value.size());
+        out.write(value.data(), value.size());
+    }
+
+    static bool ReadU32(std::istream& in, uint32_t& value)
+    {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+
+    static bool ReadString(std::istream& in, std::string& value)
+    {
+        uint32_t size;
+        if (!ReadU32(in, size))            return false;
+        if (size > CACHE_FILE_MAX_STRING)  return false;
+
+        value.resize(size);
+        return size == 0 || static_cast<bool>(in.read(&value[0], size));
+    }
+
+    // Copies the bytecode of re into dest
+    static bool CopyCode(const pcrecpp::RE& re, std::string& dest)
+    {
+        size_t size;
+        const pcre *compiled = re.compiled();
+        if (compiled == NULL || pcre_fullinfo(compiled, NULL, PCRE_INFO_SIZE, &size) != 0)
+        {
+            return false;
+        }
+
+        dest.assign(reinterpret_cast<const char*>(compiled), size);
+        return true;
+    }
+
+    int Save(const std::string& path, std::string* error)
+    {
+        State& state = GetState();
+        std::map<Key, Code> snapshot;
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            snapshot = state.stored;
+
+            std::map<Key, std::weak_ptr<const Pattern> >::const_iterator it;
+            for (it = state.entries.begin(); it != state.entries.end(); it++)
+            {
+                std::shared_ptr<const Pattern> pattern = it->second.lock();
+                Code code;
+                if (!pattern || !CopyCode(pattern->re(), code.code)) continue;
+                if (pattern->ascii_re() != NULL &&
+                    !CopyCode(*pattern->ascii_re(), code.ascii_code)) continue;
+
+                snapshot[it->first] = code;
+            }
+        }
+
+        // Write to a temporary file first so that readers never see a
+        // partially written cache
+        std::string tmp = path + ".tmp";
+        std::ofstream out(tmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            *error = "Unable to open " + tmp + " for writing";
+            return -1;
+        }
+
+        WriteString(out, CACHE_FILE_MAGIC);
+        WriteString(out, Fingerprint());
+        WriteU32(out, snapshot.size());
+
+        std::map<Key, Code>::const_iterator it;
+        for (it = snapshot.begin(); it != snapshot.end(); it++)
+        {
+            uint64_t hash = Hash(it->first.first, it->first.second);
+            out.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+            WriteU32(out, it->first.second);
+            WriteString(out, it->first.first);
+            WriteString(out, it->second.code);
+            WriteString(out, it->second.ascii_code);
+
+            uint64_t checksum = Checksum(it->second);
+            out.write(reinterpret_cast<const char*>(&checksum), sizeof(checksum));
+        }
+
+        out.close();
+        if (!out || std::rename(tmp.c_str(), path.c_str()) != 0)
+        {
+            std::remove(tmp.c_str());
+            *error = "Unable to write " + path;
+            return -1;
+        }
+
+        return snapshot.size();
+    }
+
+    int Load(const std::string& path, std::string* error)
+    {
+        std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+        if (!in)
+        {
+            *error = "Unable to open " + path + " for reading";
+            return -1;
+        }
+
+        std::string magic, fingerprint;
+        uint32_t count;
+        if (!ReadString(in, magic) || magic.compare(0, CACHE_FILE_MAGIC_PREFIX_LENGTH,
+            CACHE_FILE_MAGIC, CACHE_FILE_MAGIC_PREFIX_LENGTH) != 0)
+        {
+            *error = path + " is not a pattern cache file";
+            return -1;
+        }
+
+        if (!ReadString(in, fingerprint) || !ReadU32(in, count))
+        {
+            *error = path + " is truncated";
+            return -1;
+        }
+
+        // Stale cache from another version of the format or another PCRE
+        // build; everything will be recompiled
+        if (magic != CACHE_FILE_MAGIC || fingerprint != Fingerprint())
+        {
+            return 0;
+        }
+
+        std::map<Key, Code> loaded;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            uint64_t hash, checksum;
+            uint32_t flags;
+            std::string source;
+            Code code;
+            if (!in.read(reinterpret_cast<char*>(&hash), sizeof(hash)) ||
+                !ReadU32(in, flags) || !ReadString(in, source) ||
+                !ReadString(in, code.code) || !ReadString(in, code.ascii_code) ||
+                !in.read(reinterpret_cast<char*>(&checksum), sizeof(checksum)))
+            {
+                *error = path + " is truncated";
+                return -1;
+            }
+
+            if (hash != Hash(source, flags))   continue;
+            if (checksum != Checksum(code))    continue;
+            if (!Validate(code.code, flags))   continue;
+            if (!code.ascii_code.empty() &&
+                !Validate(code.ascii_code, flags & ~PCRE_UTF8)) continue;
+
+            loaded[Key(source, flags)] = code;
+        }
+
+        State& state = GetState();
+        std::lock_guard<std::mutex> lock(state.mutex);
+        std::map<Key, Code>::iterator it;
+        for (it = loaded.begin(); it != loaded.end(); it++)
+        {
+            Code& code = state.stored[it->first];
+            state.stored_size += it->second.size();
+            state.stored_size -= code.size();
+            code = it->second;
+        }
+
+        return loaded.size();
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <stdint.h>
+
+#include "./pattern.h"
+
+// Process-wide cache of compiled patterns, keyed by the pattern source and
+// the flags that affect compilation.  Entries are refcounted by the filters
+// using them and are dropped as soon as the last one goes away.
+namespace PatternCache
+{
+    struct Stats
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t disk_hits;
+        size_t entries;
+        size_t memory_usage;
+    };
+
+    std::shared_ptr<const Pattern> Get(const std::string& source, int flags);
+    Stats GetStats();
+
+    // Persist the bytecode of every known pattern to path, or read it back so
+    // that later cache misses adopt the stored bytecode instead of calling
+    // pcre_compile.  Files written by a different PCRE version or build
+    // configuration are ignored.  Both return the number of patterns
+    // written/loaded, or -1 with *error set on I/O or format errors.
+    int Save(const std::string& path, std::string* error);
+    int Load(const std::string& path, std::string* error);
+}
@@ -0,0 +1,105 @@
+#include <string>
+#include <vector>
+
+#include "./replacement.h"
+
+Replacement::Replacement() : m_MaxGroup(-1), m_Valid(true)
+{
+}
+
+Replacement::Replacement(const std::string& rewrite) : m_MaxGroup(-1), m_Valid(true)
+{
+    std::string text;
+    for (size_t i = 0; i < rewrite.size(); i++)
+    {
+        char c = rewrite[i];
+        if (c != '\\')
+        {
+            text.push_back(c);
+            continue;
+        }
+
+        c = (i + 1 < rewrite.size()) ? rewrite[++i] : '\0';
+        if (c == '\\')
+        {
+            text.push_back('\\');
+        }
+        else if (c >= '0' && c <= '9')
+        {
+            if (!text.empty())
+            {
+                Segment segment = { -1, text };
+                this->m_Segments.push_back(segment);
+                text.clear();
+            }
+
+            Segment segment = { c - '0', "" };
+            this->m_Segments.push_back(segment);
+            if (segment.group > this->m_MaxGroup)
+            {
+                this->m_MaxGroup = segment.group;
+            }
+        }
+        else
+        {
+            // Rewrite stops at the first invalid escape
+            this->m_Valid = false;
+            break;
+        }
+    }
+
+    if (!text.empty())
+    {
+        Segment segment = { -1, text };
+        this->m_Segments.push_back(segment);
+    }
+}
+
+bool Replacement::append(std::string* out, const char *subject,
+    const int *vec, int matches) const
+{
+    // Without group references there is at most one piece of text
+    if (this->m_MaxGroup < 0)
+    {
+        if (!this->m_Segments.empty())
+        {
+            out->append(this->m_Segments[0].text);
+        }
+
+        return this->m_Valid;
+    }
+
+    std::vector<Segment>::const_iterator it;
+    for (it = this->m_Segments.begin(); it != this->m_Segments.end(); it++)
+    {
+        if (it->group < 0)
+        {
+            out->append(it->text);
+            continue;
+        }
+
+        if (it->group >= matches)
+        {
+            return false;
+        }
+
+        int start = vec[2 * it->group];
+        if (start >= 0)
+        {
+            out->append(subject + start, vec[2 * it->group + 1] - start);
+        }
+    }
+
+    return this->m_Valid;
+}
+
+bool Replacement::Rewrite(std::string* out, const pcrecpp::StringPiece& text,
+    const int *vec, int veclen) const
+{
+    return this->append(out, text.data(), vec, veclen);
+}
+
+int Replacement::MaxGroup() const
+{
+    return this->m_MaxGroup;
+}
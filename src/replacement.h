@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <pcrecpp.h>
+
+// A filter's replacement string, split once into literal text and \0-\9
+// group references instead of being re-parsed for every match.
+class Replacement : public pcrecpp::RE::Rewriter
+{
+    public:
+        Replacement();
+        explicit Replacement(const std::string& rewrite);
+
+        // Appends the replacement for one match to out, exactly as
+        // pcrecpp::RE::Rewrite would: vec holds the offsets of the match
+        // and its groups in subject, and matches is the number of pairs in
+        // vec.  Returns false on an invalid escape or a reference to a group
+        // beyond matches, after appending everything before it.
+        bool append(std::string* out, const char *subject,
+            const int *vec, int matches) const;
+
+        // For pcrecpp::RE::Replace and GlobalReplace
+        virtual bool Rewrite(std::string* out, const pcrecpp::StringPiece& text,
+            const int *vec, int veclen) const;
+
+        // Highest group referenced, or -1 if there are none
+        virtual int MaxGroup() const;
+
+    private:
+        struct Segment
+        {
+            // Group to insert, or -1 to insert text
+            int group;
+            std::string text;
+        };
+
+        std::vector<Segment> m_Segments;
+        int m_MaxGroup;
+        // False if the rewrite string has an invalid escape after the last
+        // segment
+        bool m_Valid;
+};
@@ -0,0 +1,140 @@
+#include <stdint.h>
+#include <cstring>
+#include <string>
+
+#include "./utf8.h"
+
+namespace Utf8
+{
+    static const uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+    // Returns a pointer to the first byte >= 0x80 in [p, end), or end.
+    // Tests 16 bytes per iteration, which the compiler keeps in registers.
+    static const unsigned char* SkipAscii(const unsigned char *p, const unsigned char *end)
+    {
+        while (end - p >= 16)
+        {
+            uint64_t a, b;
+            memcpy(&a, p, sizeof(a));
+            memcpy(&b, p + 8, sizeof(b));
+            if ((a | b) & HIGH_BITS) break;
+            p += 16;
+        }
+
+        while (p < end && *p < 0x80)
+        {
+            p++;
+        }
+
+        return p;
+    }
+
+    static bool IsContinuation(unsigned char c)
+    {
+        return (c & 0xc0) == 0x80;
+    }
+
+    bool IsAscii(const char *data, size_t length)
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(data);
+        return SkipAscii(p, p + length) == p + length;
+    }
+
+    bool IsValid(const char *data, size_t length)
+    {
+        const unsigned char *p = reinterpret_cast<const unsigned char*>(data);
+        const unsigned char *end = p + length;
+
+        while (p < end)
+        {
+            unsigned char c = *p;
+            if (c < 0x80)
+            {
+                p = SkipAscii(p, end);
+                continue;
+            }
+
+            // The allowed range of the second byte depends on the lead byte;
+            // this is what rules out overlong forms, surrogates and code
+            // points above U+10FFFF
+            size_t trail;
+            unsigned char low = 0x80, high = 0xbf;
+            if (c < 0xc2)
+            {
+                // Stray continuation byte, or overlong two-byte form
+                return false;
+            }
+            else if (c < 0xe0)
+            {
+                trail = 1;
+            }
+            else if (c < 0xf0)
+            {
+                trail = 2;
+                if (c == 0xe0) low = 0xa0;
+                if (c == 0xed) high = 0x9f;
+            }
+            else if (c < 0xf5)
+            {
+                trail = 3;
+                if (c == 0xf0) low = 0x90;
+                if (c == 0xf4) high = 0x8f;
+            }
+            else
+            {
+                return false;
+            }
+
+            if (static_cast<size_t>(end - p) <= trail) return false;
+            if (p[1] < low || p[1] > high)              return false;
+
+            for (size_t i = 2; i <= trail; i++)
+            {
+                if (!IsContinuation(p[i])) return false;
+            }
+
+            p += trail + 1;
+        }
+
+        return true;
+    }
+
+    void FromLatin1(std::string* text)
+    {
+        const unsigned char *begin = reinterpret_cast<const unsigned char*>(text->data());
+        const unsigned char *end = begin + text->size();
+        const unsigned char *first = SkipAscii(begin, end);
+        if (first == end)
+        {
+            return;
+        }
+
+        // Every byte >= 0x80 becomes two bytes
+        size_t extra = 0;
+        for (const unsigned char *p = first; p < end; p++)
+        {
+            extra += *p >> 7;
+        }
+
+        size_t from = text->size();
+        size_t to = from + extra;
+        size_t stop = first - begin;
+        text->resize(to);
+
+        // Expand from the end so that nothing is overwritten before it is read
+        char *data = &(*text)[0];
+        while (from > stop)
+        {
+            unsigned char c = data[--from];
+            if (c < 0x80)
+            {
+                data[--to] = c;
+            }
+            else
+            {
+                data[--to] = 0x80 | (c & 0x3f);
+                data[--to] = 0xc0 | (c >> 6);
+            }
+        }
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+namespace Utf8
+{
+    // True if data contains no bytes >= 0x80.
+    bool IsAscii(const char *data, size_t length);
+
+    // True if data is well-formed UTF-8 by the same rules pcre_exec applies
+    // in UTF-8 mode: no overlong forms, surrogates, code points above
+    // U+10FFFF or truncated sequences.
+    bool IsValid(const char *data, size_t length);
+
+    // Converts text from ISO-8859-1 to UTF-8 in place.
+    void FromLatin1(std::string* text);
+}
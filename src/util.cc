@@ -1,9 +1,13 @@
+#include <cstring>
 #include <v8.h>
 #include <nan.h>
 
 #include "./filter.h"
+#include "./utf8.h"
+#include "./wordlist.h"
 #include "./util.h"
 
+using v8::Array;
 using v8::Boolean;
 using v8::Local;
 using v8::Object;
@@ -39,6 +43,88 @@ namespace Util
         return true;
     }
 
+    bool ToStringVector(const Local<Value>& value, std::vector<std::string>& dest)
+    {
+        if (!value->IsArray()) return false;
+
+        Local<Array> array = value.As<Array>();
+        std::vector<std::string> strings;
+        for (uint32_t i = 0; i < array->Length(); i++)
+        {
+            Local<Value> element;
+            if (!Nan::Get(array, i).ToLocal(&element)) return false;
+            if (!element->IsString())                  return false;
+
+            strings.push_back(*Nan::Utf8String(element));
+        }
+
+        dest.swap(strings);
+        return true;
+    }
+
+    // Reads value as UTF-8 into dest, reusing dest's storage.  V8 keeps
+    // most strings as one byte per character, and those are copied out
+    // directly and only transcoded if they have characters beyond ASCII,
+    // rather than going through V8's UTF-8 writer.  Like the C string
+    // messages used to be read as, dest stops at the first NUL.
+    //
+    // Returns true if value is a string that dest represents exactly,
+    // which is not the case for non-strings, strings containing NUL, or
+    // unpaired surrogates, which become U+FFFD.
+    bool ReadUtf8(const Local<Value>& value, std::string& dest)
+    {
+        bool exact;
+        if (value->IsString() && value.As<String>()->IsOneByte())
+        {
+            Local<String> str = value.As<String>();
+            int length = str->Length();
+            dest.resize(length);
+            str->WriteOneByte(v8::Isolate::GetCurrent(),
+                reinterpret_cast<uint8_t*>(&dest[0]), 0, length,
+                String::NO_NULL_TERMINATION);
+            Utf8::FromLatin1(&dest);
+            exact = true;
+        }
+        else
+        {
+            Nan::Utf8String utf8(value);
+            dest.assign(*utf8, utf8.length());
+            exact = value->IsString() && dest.find("\xef\xbf\xbd") == std::string::npos;
+        }
+
+        const char *nul = static_cast<const char*>(memchr(dest.data(), 0, dest.size()));
+        if (nul != NULL)
+        {
+            dest.resize(nul - dest.data());
+            return false;
+        }
+
+        return exact;
+    }
+
+    // ASCII results are handed to V8 as one-byte strings, which it can copy
+    // without decoding
+    bool ToJSString(const std::string& src, Local<String>& dest)
+    {
+        if (Utf8::IsAscii(src.data(), src.size()))
+        {
+            return Nan::NewOneByteString(
+                reinterpret_cast<const uint8_t*>(src.data()), src.size()).ToLocal(&dest);
+        }
+
+        return Nan::New<String>(src).ToLocal(&dest);
+    }
+
+    inline bool SafeGetValue(const Local<Object>& obj, const char *key, Local<Value>& dest)
+    {
+        Local<String> objKey;
+
+        if (!Nan::New<String>(key).ToLocal(&objKey)) return false;
+        if (!Nan::Get(obj, objKey).ToLocal(&dest))   return false;
+
+        return true;
+    }
+
     inline bool SafeSetString(const Local<Object>& obj, const char *key, std::string value)
     {
         Local<String> objKey;
@@ -77,17 +163,51 @@ namespace Util
         return true;
     }
 
+    // A filter with a words array instead of a source, and an optional
+    // boundary ("word" by default, or "none")
+    static bool FromJSWordList(const Local<Object>& obj, const Local<Value>& value,
+        const std::string& name, const std::string& flags,
+        const std::string& replacement, bool active, bool filter_links,
+        Filter& out)
+    {
+        std::vector<std::string> words;
+        Local<Value> boundaryValue;
+        WordList::Boundary boundary = WordList::BOUNDARY_WORD;
+
+        if (!ToStringVector(value, words))                  return false;
+        if (!SafeGetValue(obj, "boundary", boundaryValue))  return false;
+
+        if (!boundaryValue->IsUndefined())
+        {
+            if (!boundaryValue->IsString()) return false;
+            if (!WordList::ParseBoundary(*Nan::Utf8String(boundaryValue), &boundary))
+                return false;
+        }
+
+        out = Filter(name, words, flags, boundary, replacement, active, filter_links);
+        return true;
+    }
+
     bool FromJSObject(const Local<Object>& obj, Filter& out)
     {
         std::string name, source, flags, replacement;
         bool active, filter_links;
+        Local<Value> words;
 
         if (!SafeGetString(obj, "name", name))              return false;
-        if (!SafeGetString(obj, "source", source))          return false;
         if (!SafeGetString(obj, "flags", flags))            return false;
         if (!SafeGetString(obj, "replace", replacement))    return false;
         if (!SafeGetBool(obj, "active", active))            return false;
         if (!SafeGetBool(obj, "filterlinks", filter_links)) return false;
+        if (!SafeGetValue(obj, "words", words))             return false;
+
+        if (!words->IsUndefined())
+        {
+            return FromJSWordList(obj, words, name, flags, replacement,
+                active, filter_links, out);
+        }
+
+        if (!SafeGetString(obj, "source", source))          return false;
 
         out = Filter(name, source, flags, replacement, active, filter_links);
         return true;
@@ -96,7 +216,28 @@ namespace Util
     bool ToJSObject(const Filter& src, Local<Object>& dst)
     {
         if (!SafeSetString(dst, "name", src.name()))              return false;
-        if (!SafeSetString(dst, "source", src.source()))          return false;
+
+        const WordList *word_list = src.word_list();
+        if (word_list != NULL)
+        {
+            const std::vector<std::string>& words = word_list->words();
+            Local<Array> array = Nan::New<Array>(words.size());
+            for (uint32_t i = 0; i < words.size(); i++)
+            {
+                Local<String> word;
+                if (!Nan::New<String>(words[i]).ToLocal(&word)) return false;
+                Nan::Set(array, i, word);
+            }
+
+            Nan::Set(dst, Nan::New<String>("words").ToLocalChecked(), array);
+            if (!SafeSetString(dst, "boundary",
+                WordList::BoundaryName(word_list->boundary())))   return false;
+        }
+        else
+        {
+            if (!SafeSetString(dst, "source", src.source()))      return false;
+        }
+
         if (!SafeSetString(dst, "flags", src.flags()))            return false;
         if (!SafeSetString(dst, "replace", src.replacement()))    return false;
         if (!SafeSetBool(dst, "active", src.active()))            return false;
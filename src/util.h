@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+#include <vector>
 #include <v8.h>
 
 #include "./filter.h"
@@ -8,11 +10,15 @@ using v8::Local;
 using v8::Object;
 using v8::Persistent;
 using v8::String;
+using v8::Value;
 
 namespace Util
 {
     bool SafeGetObject(const Local<Object>& obj, uint32_t index, Local<Object>& dest);
     bool SafeGetString(const Local<Object>& obj, const char *key, std::string& dest);
+    bool ToStringVector(const Local<Value>& value, std::vector<std::string>& dest);
+    bool ReadUtf8(const Local<Value>& value, std::string& dest);
+    bool ToJSString(const std::string& src, Local<String>& dest);
     bool FromJSObject(const Local<Object>& obj, Filter& dest);
     bool ToJSObject(const Filter& src, Local<Object>& dest);
 }
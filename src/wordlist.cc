@@ -0,0 +1,131 @@
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./wordlist.h"
+
+WordList::WordList(const std::vector<std::string>& words, bool caseless, Boundary boundary)
+    : m_Words(words),
+    m_Caseless(caseless),
+    m_Boundary(boundary),
+    m_Automaton(caseless)
+{
+    // Needle ids are indices into m_Words; empty words are never added
+    for (size_t i = 0; i < this->m_Words.size(); i++)
+    {
+        this->m_Automaton.add(this->m_Words[i], i);
+    }
+
+    this->m_Automaton.build();
+}
+
+const std::vector<std::string>& WordList::words() const
+{
+    return this->m_Words;
+}
+
+bool WordList::caseless() const
+{
+    return this->m_Caseless;
+}
+
+WordList::Boundary WordList::boundary() const
+{
+    return this->m_Boundary;
+}
+
+size_t WordList::memory_usage() const
+{
+    size_t usage = this->m_Automaton.memory_usage();
+    for (size_t i = 0; i < this->m_Words.size(); i++)
+    {
+        usage += this->m_Words[i].capacity();
+    }
+
+    return usage;
+}
+
+static bool IsWordChar(unsigned char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') ||
+        (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool WordList::is_bounded(const std::string& subject, size_t start, size_t end) const
+{
+    if (this->m_Boundary == BOUNDARY_NONE)
+    {
+        return true;
+    }
+
+    return (start == 0 || !IsWordChar(subject[start - 1])) &&
+        (end == subject.size() || !IsWordChar(subject[end]));
+}
+
+void WordList::find(const std::string& subject,
+    std::vector<std::pair<size_t, size_t> >* out) const
+{
+    // Length of the longest acceptable match starting at each offset.
+    // Only sized once something matches, and kept to reuse its storage.
+    static thread_local std::vector<size_t> longest;
+    longest.clear();
+
+    this->m_Automaton.scan(subject.data(), subject.size(),
+        [this, &subject](size_t end, unsigned int id) {
+            size_t length = this->m_Words[id].size();
+            size_t start = end - length;
+            if (!this->is_bounded(subject, start, end))
+            {
+                return true;
+            }
+
+            if (longest.empty())
+            {
+                longest.resize(subject.size(), 0);
+            }
+
+            if (length > longest[start])
+            {
+                longest[start] = length;
+            }
+
+            return true;
+        });
+
+    size_t i = 0;
+    while (i < longest.size())
+    {
+        if (longest[i] > 0)
+        {
+            out->push_back(std::make_pair(i, longest[i]));
+            i += longest[i];
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+bool WordList::ParseBoundary(const std::string& name, Boundary* boundary)
+{
+    if (name == "word")
+    {
+        *boundary = BOUNDARY_WORD;
+    }
+    else if (name == "none")
+    {
+        *boundary = BOUNDARY_NONE;
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+const char* WordList::BoundaryName(Boundary boundary)
+{
+    return boundary == BOUNDARY_WORD ? "word" : "none";
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./ahocorasick.h"
+
+// The compiled form of a word list filter: a set of words matched with a
+// single automaton, so the cost of a scan does not depend on how many words
+// there are.  Immutable and shared between copies of a Filter, like Pattern.
+class WordList
+{
+    public:
+        enum Boundary
+        {
+            // Words match anywhere, including inside other words
+            BOUNDARY_NONE,
+            // Words only match if not directly preceded or followed by a
+            // word character (ASCII letter, digit or underscore), like \b
+            BOUNDARY_WORD
+        };
+
+        // If caseless is set, ASCII letters match either case; all other
+        // characters must match exactly.
+        WordList(const std::vector<std::string>& words, bool caseless, Boundary boundary);
+
+        WordList(const WordList&) = delete;
+        WordList& operator=(const WordList&) = delete;
+
+        const std::vector<std::string>& words() const;
+        bool caseless() const;
+        Boundary boundary() const;
+
+        size_t memory_usage() const;
+
+        // Appends the (offset, length) of every match in subject to out.
+        // Matches are leftmost-longest and do not overlap.
+        void find(const std::string& subject,
+            std::vector<std::pair<size_t, size_t> >* out) const;
+
+        static bool ParseBoundary(const std::string& name, Boundary* boundary);
+        static const char* BoundaryName(Boundary boundary);
+
+    private:
+        bool is_bounded(const std::string& subject, size_t start, size_t end) const;
+
+        std::vector<std::string> m_Words;
+        bool m_Caseless;
+        Boundary m_Boundary;
+        AhoCorasick m_Automaton;
+};
@@ -1,4 +1,7 @@
 var assert = require('assert');
+var fs = require('fs');
+var os = require('os');
+var path = require('path');
 var FilterList = require('../index');
 
 var filters = [
@@ -134,6 +137,161 @@ describe('FilterList', function () {
         });
     });
 
+    describe('#cacheStats', function () {
+        it('should share compiled patterns between lists', function () {
+            var before = FilterList.cacheStats();
+            var a = new FilterList(filters);
+            var b = new FilterList(filters);
+            var after = FilterList.cacheStats();
+
+            assert(after.hits - before.hits >= filters.length);
+            assert(after.entries >= filters.length);
+            assert(after.memoryUsage >= a.memoryUsage());
+        });
+
+        it('should ignore the g flag when sharing patterns', function () {
+            var f = {
+                name: 'global',
+                source: 'cache(d|e)',
+                replace: 'x',
+                flags: 'gi',
+                active: true,
+                filterlinks: false
+            };
+            var a = new FilterList([f]);
+            var before = FilterList.cacheStats();
+            f.flags = 'i';
+            var b = new FilterList([f]);
+            var after = FilterList.cacheStats();
+
+            assert.equal(after.hits - before.hits, 1);
+            assert.equal(after.misses, before.misses);
+        });
+    });
+
+    describe('#execStats', function () {
+        it('should count ASCII messages separately', function () {
+            var list = new FilterList(filters);
+            var before = FilterList.execStats();
+            assert.equal(list.filter('*bold*'), '<strong>bold</strong>');
+            assert.equal(list.filter('*b\u00f6ld*'), '<strong>b\u00f6ld</strong>');
+            var after = FilterList.execStats();
+
+            assert.equal(after.messages - before.messages, 2);
+            assert.equal(after.asciiMessages - before.asciiMessages, 1);
+        });
+
+        it('should not allocate once the buffers have grown', function () {
+            // Only debug builds count allocations
+            if (FilterList.execStats().allocations === undefined) {
+                this.skip();
+            }
+
+            var list = new FilterList(filters);
+            var messages = ['*bold* _it_ `code`', 'nothing to see', '[sp]x[/sp] ~~s~~'];
+            messages.forEach(function (msg) {
+                list.filter(msg);
+            });
+
+            var before = FilterList.execStats().allocations;
+            for (var i = 0; i < 100; i++) {
+                list.filter(messages[i % messages.length]);
+            }
+
+            assert.equal(FilterList.execStats().allocations - before, 0);
+        });
+    });
+
+    describe('#savePatternCache', function () {
+        var file = path.join(os.tmpdir(), 'cytubefilters-' + process.pid + '.cache');
+
+        afterEach(function () {
+            try {
+                fs.unlinkSync(file);
+            } catch (e) {
+            }
+        });
+
+        it('should round-trip the compiled patterns of live filters', function () {
+            var list = new FilterList(filters);
+            var saved = FilterList.savePatternCache(file);
+            assert(saved >= filters.length);
+            assert.equal(FilterList.loadPatternCache(file), saved);
+        });
+
+        it('should use stored bytecode for filters compiled after loading', function () {
+            var f = {
+                name: 'stored',
+                source: 'stored(\\d+)',
+                replace: '<\\1>',
+                flags: 'g',
+                active: true,
+                filterlinks: false
+            };
+            var list = new FilterList([f]);
+            FilterList.savePatternCache(file);
+            list = null;
+
+            FilterList.loadPatternCache(file);
+            // Depending on GC the first list's pattern is either still live
+            // (cache hit) or rebuilt from the stored bytecode (disk hit)
+            var before = FilterList.cacheStats();
+            var fresh = new FilterList([f]);
+            var after = FilterList.cacheStats();
+            assert.equal(fresh.filter('stored12 stored3'), '<12> <3>');
+            assert.equal(after.hits + after.diskHits, before.hits + before.diskHits + 1);
+        });
+
+        it('should recompile an entry whose bytecode is corrupt', function () {
+            var f = {
+                name: 'corrupt',
+                source: 'corrupt(\\d+)x',
+                replace: '<\\1>',
+                flags: 'g',
+                active: true,
+                filterlinks: false
+            };
+            var list = new FilterList([f]);
+            var saved = FilterList.savePatternCache(file);
+            list = null;
+
+            // Flip a byte in the middle of the entry's bytecode, which
+            // follows the source and its own length
+            var buf = fs.readFileSync(file);
+            var start = buf.indexOf(f.source) + f.source.length;
+            var length = buf['readUInt32' + os.endianness()](start);
+            buf[start + 4 + Math.floor(length / 2)] ^= 0xff;
+            fs.writeFileSync(file, buf);
+
+            assert.equal(FilterList.loadPatternCache(file), saved - 1);
+            var before = FilterList.cacheStats();
+            var fresh = new FilterList([f]);
+            var after = FilterList.cacheStats();
+            assert.equal(fresh.filter('corrupt12x corrupt3x'), '<12> <3>');
+            assert.equal(after.diskHits, before.diskHits);
+        });
+
+        it('should ignore a file written in an older format', function () {
+            function str(value) {
+                var length = Buffer.alloc(4);
+                length['writeUInt32' + os.endianness()](value.length, 0);
+                return Buffer.concat([length, Buffer.from(value)]);
+            }
+
+            fs.writeFileSync(file, Buffer.concat([
+                str('CYTUBEFILTERS-PATTERNS-1'), str('old build'), Buffer.alloc(4)
+            ]));
+            assert.equal(FilterList.loadPatternCache(file), 0);
+        });
+
+        it('should throw an error for a file that is not a pattern cache', function () {
+            fs.writeFileSync(file, 'not a cache');
+            assert.throws(function () {
+                FilterList.loadPatternCache(file);
+            }, /is not a pattern cache file/);
+        });
+    });
+
     describe('#pack', function () {
         it('should re-pack the original list correctly', function () {
             var f2 = filters.slice().map(function (f) {
@@ -263,6 +421,15 @@ describe('FilterList', function () {
             });
         });
 
+        it('should not change anything if a later field is invalid', function () {
+            var list = new FilterList(filters);
+            assert.throws(function () {
+                list.updateFilter({ name: 'bold', source: 'x', active: 42 });
+            }, /Field active must be a boolean/);
+
+            assert.deepEqual(list.pack(), new FilterList(filters).pack());
+        });
+
         it('should update source correctly', function () {
             for (var i = 0; i < filters.length; i++) {
                 var newf = {
@@ -434,6 +601,18 @@ describe('FilterList', function () {
             }, /Argument out of range/);
         });
 
+        it('should still find filters by name after moving and removing', function () {
+            var list = new FilterList(filters);
+            list.moveFilter(0, filters.length - 1);
+            list.removeFilter({ name: filters[1].name });
+            list.updateFilter({ name: filters[0].name, replace: 'moved' });
+
+            var packed = list.pack();
+            assert.equal(packed.length, filters.length - 1);
+            assert.equal(packed[packed.length - 1].name, filters[0].name);
+            assert.equal(packed[packed.length - 1].replace, 'moved');
+        });
+
         it('should move filters correctly', function () {
             // Pseudorandom sequence; hardcoded so that tests are deterministic
             var moves = [4, 1, 4, 0, 5, 5, 2, 3, 0, 3, 5, 4, 5, 4, 5, 3, 3, 4, 5, 0, 3];
@@ -453,6 +632,82 @@ describe('FilterList', function () {
         });
     });
 
+    describe('word lists', function () {
+        var wordList = {
+            name: 'blocklist',
+            words: ['heck', 'darn', 'darnit'],
+            boundary: 'word',
+            replace: '****',
+            flags: 'gi',
+            active: true,
+            filterlinks: false
+        };
+
+        it('should replace the longest whole word', function () {
+            var list = new FilterList([wordList]);
+            assert.equal(list.filter('Darnit, heck! dheck darn'), '****, ****! dheck ****');
+        });
+
+        it('should match inside words without a boundary', function () {
+            var list = new FilterList([wordList]);
+            list.updateFilter({ name: 'blocklist', boundary: 'none' });
+            assert.equal(list.filter('dheck'), 'd****');
+        });
+
+        it('should round-trip through pack', function () {
+            var list = new FilterList([wordList]);
+            var packed = list.pack();
+            assert.deepEqual(packed[0].words, wordList.words);
+            assert.equal(packed[0].boundary, 'word');
+            assert.equal(packed[0].source, undefined);
+            assert.equal(new FilterList(packed).filter('heck'), '****');
+        });
+
+        it('should throw an error for an invalid boundary', function () {
+            var f = JSON.parse(JSON.stringify(wordList));
+            f.boundary = 'sentence';
+            assert.throws(function () {
+                new FilterList([f]);
+            }, /Filter at index 0 is invalid/);
+        });
+
+        it('should convert between word lists and regex filters', function () {
+            var list = new FilterList([wordList]);
+            list.updateFilter({ name: 'blocklist', source: 'h.ck' });
+            assert.equal(list.filter('hack'), '****');
+            assert.throws(function () {
+                list.updateFilter({ name: 'blocklist', boundary: 'none' });
+            }, /only applies to word list filters/);
+
+            list.updateFilter({ name: 'blocklist', words: ['hack'] });
+            assert.equal(list.pack()[0].boundary, 'word');
+            assert.equal(list.filter('hack hackney'), '**** hackney');
+        });
+    });
+
+    describe('#memoryUsage', function () {
+        it('should return 0 for an empty list', function () {
+            var list = new FilterList();
+            assert.equal(list.memoryUsage(), 0);
+        });
+
+        it('should grow as filters are added', function () {
+            var list = new FilterList(filters);
+            var before = list.memoryUsage();
+            assert(before > 0);
+
+            list.addFilter({
+                name: 'extra',
+                source: 'abc(d|e)+',
+                replace: 'x',
+                flags: 'g',
+                active: true,
+                filterlinks: false
+            });
+            assert(list.memoryUsage() > before);
+        });
+    });
+
     describe('#filter', function () {
         it('should filter a string correctly', function () {
             var list = new FilterList(filters);
@@ -491,6 +746,255 @@ describe('FilterList', function () {
             assert.equal(list.filter(src), expect);
         });
 
+        it('should filter plain string sources like PCRE would', function () {
+            var list = new FilterList([
+                {
+                    name: 'quoted',
+                    source: FilterList.quoteMeta('$1.50 (each)'),
+                    replace: '[\\0]',
+                    flags: 'g',
+                    active: true,
+                    filterlinks: false
+                },
+                {
+                    name: 'caseless',
+                    source: 'kiss',
+                    replace: 'x',
+                    flags: 'gi',
+                    active: true,
+                    filterlinks: false
+                }
+            ]);
+
+            assert.equal(list.filter('$1.50 (each), $1.50 (each)'),
+                '[$1.50 (each)], [$1.50 (each)]');
+            // PCRE folds K to U+212A KELVIN SIGN in UTF-8 mode
+            assert.equal(list.filter('KISS \u212aiss'), 'x x');
+        });
+
+        it('should read Latin-1 and two-byte strings as UTF-8', function () {
+            var list = new FilterList([{
+                name: 'accent',
+                source: '\u00e9+',
+                flags: 'g',
+                replace: '<\\0>',
+                active: true,
+                filterlinks: false
+            }]);
+
+            // V8 stores the first as one byte per character
+            assert.equal(list.filter('caf\u00e9 \u00ff\u00e9\u00e9'),
+                'caf<\u00e9> \u00ff<\u00e9\u00e9>');
+            assert.equal(list.filter('caf\u00e9 \u2603'), 'caf<\u00e9> \u2603');
+            assert.equal(list.filter('plain'), 'plain');
+        });
+
+        it('should replace unpaired surrogates even if nothing matched', function () {
+            var list = new FilterList(filters);
+            assert.equal(list.filter('a\ud800b'), 'a\ufffdb');
+            assert.equal(list.filter('a\ud83d\ude00b'), 'a\ud83d\ude00b');
+        });
+
+        it('should use the list as it was if toString changes it', function () {
+            var list = new FilterList(filters);
+            var message = {
+                toString: function () {
+                    list.setFilters([]);
+                    return '*bold*';
+                }
+            };
+
+            assert.equal(list.filter(message), '<strong>bold</strong>');
+            assert.equal(list.filter('*bold*'), '*bold*');
+        });
+
+        it('should use the list as it was if toString adds a filter', function () {
+            var list = new FilterList(filters);
+            var message = {
+                toString: function () {
+                    list.addFilter({
+                        name: 'added',
+                        source: 'bold',
+                        replace: 'b',
+                        flags: 'g',
+                        active: true,
+                        filterlinks: false
+                    });
+                    return '*bold* _it_';
+                }
+            };
+
+            assert.equal(list.filter(message), '<strong>bold</strong> <em>it</em>');
+            assert.equal(list.filter('*bold*'), '<strong>b</strong>');
+        });
+
+        it('should cut messages off at the first NUL', function () {
+            var list = new FilterList(filters);
+            assert.equal(list.filter('a\u0000b'), 'a');
+            assert.equal(list.filter('\u00e9\u0000*b*'), '\u00e9');
+            assert.equal(list.filter('\u20ac\u0000*b*'), '\u20ac');
+        });
+
+        it('should match running each filter on its own', function () {
+            function literal(name, text, replace, flags) {
+                return {
+                    name: name,
+                    source: FilterList.quoteMeta(text),
+                    replace: replace,
+                    flags: flags,
+                    active: true,
+                    filterlinks: false
+                };
+            }
+
+            // Adjacent plain string filters like these are applied in a
+            // single pass when they cannot affect each other
+            var list = [
+                literal('smile', ':)', '[smile]', 'g'),
+                literal('frown', ':(', '[frown]', 'g'),
+                literal('lol', 'lol', 'LOL', 'gi'),
+                literal('shrug', '^_^', '\\0\\0', 'g'),
+                literal('erase', 'zz', '', 'g'),
+                literal('after', 'q', 'zz', 'g')
+            ];
+            var corpus = [
+                ':) :( lol LoL ^_^', 'zzq', 'qzz', ':):):)', 'lolol', ':(lol:)',
+                'caf\u00e9 lol :)', '', 'nothing here'
+            ];
+
+            var combined = new FilterList(list);
+            var separate = list.map(function (f) {
+                return new FilterList([f]);
+            });
+
+            corpus.forEach(function (msg) {
+                [1000, 12].forEach(function (limit) {
+                    var expected = separate.reduce(function (s, l) {
+                        return l.filter(s, false, limit);
+                    }, msg);
+                    assert.equal(combined.filter(msg, false, limit), expected);
+                });
+            });
+        });
+
+        it('should match splitting every run up, for random filters', function () {
+            // Seeded so that a failure can be reproduced
+            var seed = 20161;
+            function random(n) {
+                seed = (Math.imul(seed, 1103515245) + 12345) >>> 0;
+                return (seed >>> 8) % n;
+            }
+
+            function pick(from, length) {
+                var s = '';
+                for (var i = 0; i < length; i++) {
+                    s += from[random(from.length)];
+                }
+                return s;
+            }
+
+            function filter(name, source, replace, flags) {
+                return {
+                    name: name,
+                    source: source,
+                    replace: replace,
+                    flags: flags,
+                    active: true,
+                    filterlinks: false
+                };
+            }
+
+            var alphabet = 'abcdefghijklmnopqrstuvwxyz0123456789';
+            for (var trial = 0; trial < 200; trial++) {
+                // Most filters use characters no earlier one did, so that
+                // they can be fused; the rest overlap and end the run
+                var unused = alphabet.split('');
+                for (var i = unused.length - 1; i > 0; i--) {
+                    var j = random(i + 1);
+                    var c = unused[i];
+                    unused[i] = unused[j];
+                    unused[j] = c;
+                }
+
+                var fresh = function (length) {
+                    if (random(5) === 0 || unused.length < length) {
+                        return pick(alphabet, length);
+                    }
+                    return unused.splice(0, length).join('');
+                };
+
+                var list = [];
+                var count = 2 + random(8);
+                for (i = 0; i < count; i++) {
+                    var replace = ['', '', '\\0', fresh(1), fresh(2)][random(5)];
+                    var flags = (random(4) === 0 ? '' : 'g') + (random(3) === 0 ? 'i' : '');
+                    list.push(filter('f' + i, fresh(1 + random(3)), replace, flags));
+                }
+
+                // A filter that is not a plain string keeps its neighbours
+                // from being fused
+                var split = [];
+                list.forEach(function (f, i) {
+                    if (i > 0) {
+                        split.push(filter('split' + i, '(?!)', '', 'g'));
+                    }
+                    split.push(f);
+                });
+
+                var fused = new FilterList(list);
+                var separate = new FilterList(split);
+
+                // Messages are made of the filters' strings, and of one
+                // filter's string around another's, which joins up if the
+                // inner one is removed.  Caseless k and s also match the
+                // Kelvin sign and long s.
+                var pieces = ['\u212a', '\u017f', '\u00e9', ' '];
+                list.forEach(function (f) {
+                    var inner = list[random(list.length)];
+                    var half = random(f.source.length + 1);
+                    pieces.push(f.source, f.source.toUpperCase(), f.replace,
+                        f.source.slice(0, half) + inner.source + f.source.slice(half));
+                });
+
+                for (var m = 0; m < 10; m++) {
+                    var msg = pick(pieces, random(16));
+                    var length = Buffer.byteLength(msg);
+                    var output = Buffer.byteLength(separate.filter(msg, false, 1000));
+                    var limits = [1000, length, length + 1, output, output + 1, 1 + random(length + 1)];
+                    limits.forEach(function (limit) {
+                        assert.equal(fused.filter(msg, false, limit),
+                            separate.filter(msg, false, limit),
+                            JSON.stringify({ trial: trial, filters: list, msg: msg, limit: limit }));
+                    });
+                }
+            }
+        });
+
+        it('should run filters that match text inserted by an earlier filter', function () {
+            var list = new FilterList([
+                {
+                    name: 'first',
+                    source: 'hello',
+                    replace: 'goodbye',
+                    flags: 'g',
+                    active: true,
+                    filterlinks: false
+                },
+                {
+                    name: 'second',
+                    source: 'bye',
+                    replace: 'BYE',
+                    flags: 'ig',
+                    active: true,
+                    filterlinks: false
+                }
+            ]);
+
+            assert.equal(list.filter('hello there'), 'goodBYE there');
+            list.updateFilter({ name: 'second', source: 'there' });
+            assert.equal(list.filter('hello there'), 'goodbye BYE');
+        });
+
         it('should limit the number of replacements', function () {
             function makeFilter(a, b) {
                 var bs = '';
@@ -521,4 +1025,232 @@ describe('FilterList', function () {
             assert((end - start) < 10);
         });
     });
+
+    describe('#setFilters', function () {
+        it('should report what it added, removed, changed and moved', function () {
+            var list = new FilterList(filters);
+            var next = filters.slice(1, 4).reverse().concat([
+                { name: 'new', source: 'x', flags: 'g', replace: 'y', active: true, filterlinks: false }
+            ]);
+            next[0] = Object.assign({}, next[0], { replace: 'changed' });
+
+            var changes = list.setFilters(next);
+            assert.deepEqual(changes.added, ['new']);
+            assert.deepEqual(changes.removed.sort(), filters.slice(0, 1).concat(filters.slice(4))
+                .map(function (f) { return f.name; }).sort());
+            assert.deepEqual(changes.changed, [next[0].name]);
+            assert.equal(changes.moved.length, 2);
+            assert.deepEqual(list.pack(), new FilterList(next).pack());
+        });
+
+        it('should report nothing for the same filters', function () {
+            var list = new FilterList(filters);
+            assert.deepEqual(list.setFilters(filters), {
+                added: [], removed: [], changed: [], moved: []
+            });
+        });
+
+        it('should leave the list as it was if a filter is invalid', function () {
+            var list = new FilterList(filters);
+            assert.throws(function () {
+                list.setFilters([filters[0], filters[0]]);
+            }, /appears more than once/);
+            assert.throws(function () {
+                list.setFilters([filters[0], 42]);
+            }, /Filter at index 1 is not an object/);
+
+            assert.deepEqual(list.pack(), new FilterList(filters).pack());
+        });
+    });
+
+    describe('#filterMany', function () {
+        it('should filter each message like filter does', function () {
+            var list = new FilterList(filters);
+            var messages = ['*bold*', 'plain', 'http://x.pic _a_', '`c`'];
+            var expected = messages.map(function (msg) {
+                return list.filter(msg, true, 20);
+            });
+
+            assert.deepEqual(list.filterMany(messages, true, 20), expected);
+        });
+
+        it('should write into a given array', function () {
+            var list = new FilterList(filters);
+            var results = [];
+            assert.strictEqual(list.filterMany(['*a*', 'b'], false, 1000, results), results);
+            assert.deepEqual(results, ['<strong>a</strong>', 'b']);
+        });
+
+        it('should drop extra entries from a given array', function () {
+            var list = new FilterList(filters);
+            var results = ['x', 'y', 'z'];
+            list.filterMany(['*a*'], false, 1000, results);
+            assert.deepEqual(results, ['<strong>a</strong>']);
+        });
+
+        it('should use the list as it was if a message changes it', function () {
+            var list = new FilterList(filters);
+            var messages = ['*a*', null, '_c_'];
+            Object.defineProperty(messages, 1, {
+                get: function () {
+                    list.addFilter({
+                        name: 'added',
+                        source: 'a',
+                        replace: 'x',
+                        flags: 'g',
+                        active: true,
+                        filterlinks: false
+                    });
+                    list.setFilters(filters.slice(0, 1));
+                    return '*b*';
+                }
+            });
+
+            assert.deepEqual(list.filterMany(messages, false, 1000),
+                ['<strong>a</strong>', '<strong>b</strong>', '<em>c</em>']);
+            assert.equal(list.filter('*a*'), '*a*');
+        });
+
+        it('should reject a non-array argument', function () {
+            var list = new FilterList(filters);
+            assert.throws(function () {
+                list.filterMany('*a*');
+            }, /must be an array/);
+        });
+    });
+
+    describe('#filterAsync', function () {
+        it('should resolve to the same result as filter', function () {
+            var list = new FilterList(filters);
+            var src = '*bold* _italic_ `code`';
+            return list.filterAsync(src).then(function (result) {
+                assert.equal(result, list.filter(src));
+            });
+        });
+
+        it('should take a callback', function (done) {
+            var list = new FilterList(filters);
+            list.filterAsync('http://x.pic', true, 1000, function (err, result) {
+                assert.ifError(err);
+                assert.equal(result, list.filter('http://x.pic', true, 1000));
+                done();
+            });
+        });
+
+        it('should use the filters as they were when called', function () {
+            var list = new FilterList(filters);
+            var pending = list.filterAsync('*bold*');
+            list.updateFilter({ name: 'bold', active: false });
+            return pending.then(function (result) {
+                assert.equal(result, '<strong>bold</strong>');
+                assert.equal(list.filter('*bold*'), '*bold*');
+            });
+        });
+    });
+
+    describe('#filterManyAsync', function () {
+        it('should resolve to the same results as filterMany', function () {
+            var list = new FilterList(filters);
+            var messages = ['*bold*', 'plain', '~~s~~', ''];
+            return list.filterManyAsync(messages, false, 1000).then(function (results) {
+                assert.deepEqual(results, list.filterMany(messages, false, 1000));
+            });
+        });
+
+        it('should reject a non-array argument', function () {
+            var list = new FilterList(filters);
+            assert.throws(function () {
+                list.filterManyAsync('*a*');
+            }, /must be an array/);
+        });
+    });
+
+    describe('#filterManyParallel', function () {
+        it('should resolve to the same results as filterMany', function () {
+            var list = new FilterList(filters);
+            var messages = [];
+            for (var i = 0; i < 200; i++) {
+                messages.push(['*bold*', 'plain', '~~s~~', ''][i % 4] + i);
+            }
+
+            return list.filterManyParallel(messages, false, 1000).then(function (results) {
+                assert.deepEqual(results, list.filterMany(messages, false, 1000));
+            });
+        });
+
+        it('should call back with an empty array for no messages', function (done) {
+            var list = new FilterList(filters);
+            list.filterManyParallel([], false, 1000, function (err, results) {
+                assert.ifError(err);
+                assert.deepEqual(results, []);
+                done();
+            });
+        });
+
+        it('should report its threads and queue', function () {
+            var list = new FilterList(filters);
+            return list.filterManyParallel(['*a*', '*b*'], false, 1000).then(function () {
+                var stats = FilterList.executorStats();
+                assert.strictEqual(stats.queueDepth, 0);
+                assert.strictEqual(stats.utilisation.length, stats.threads);
+                assert(stats.maxLatency >= stats.meanLatency);
+            });
+        });
+    });
+
+    describe('worker threads', function () {
+        var threads;
+        try {
+            threads = require('worker_threads');
+        } catch (e) {
+            threads = null;
+        }
+
+        function runWorker(message) {
+            var code = [
+                'var threads = require("worker_threads");',
+                'var FilterList = require(threads.workerData.index);',
+                'var list = new FilterList(threads.workerData.filters);',
+                'threads.parentPort.postMessage(list.filter(threads.workerData.message));'
+            ].join('\n');
+
+            return new Promise(function (resolve, reject) {
+                var worker = new threads.Worker(code, {
+                    eval: true,
+                    workerData: {
+                        index: path.join(__dirname, '..', 'index'),
+                        filters: filters,
+                        message: message
+                    }
+                });
+                worker.once('message', resolve);
+                worker.once('error', reject);
+            });
+        }
+
+        it('should load and filter in several workers at once', function () {
+            if (!threads) {
+                this.skip();
+            }
+
+            var messages = ['*bold*', '_italic_', '`code`'];
+            var list = new FilterList(filters);
+            return Promise.all(messages.map(runWorker)).then(function (results) {
+                assert.deepEqual(results, messages.map(function (msg) {
+                    return list.filter(msg);
+                }));
+            });
+        });
+
+        it('should count messages from every thread in execStats', function () {
+            if (!threads) {
+                this.skip();
+            }
+
+            var before = FilterList.execStats();
+            return runWorker('*bold*').then(function () {
+                assert.equal(FilterList.execStats().messages - before.messages, 1);
+            });
+        });
+    });
 });